@@ -0,0 +1,200 @@
+/*
+ * Ping-pong benchmark for the context switching primitive.
+ * Two contexts switch back and forth between each other, once with the original
+ * sigsetjmp/siglongjmp mechanism (saving and restoring the signal mask on every switch),
+ * and once with context_switch, which only switches the registers.
+ * Then two threads of the library yield back and forth - Once re-arming the timer on every switch, as the
+ * library used to before it checked the timer's expiry against the start of the quantum instead, and once as is.
+ */
+
+// The ping-pong jumps between stacks, which the fortified siglongjmp takes for a jump into a returned frame
+#undef _FORTIFY_SOURCE
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <setjmp.h>
+#include <sys/time.h>
+
+#include "context.h"
+#include "uthreads.h"
+
+constexpr size_t bench_stack_size = 64 * 1024;
+constexpr long default_iterations = 1000000;
+constexpr int quantum_usecs = 10000;
+
+static long g_iterations = default_iterations;
+// Round trips completed by the sigsetjmp ping-pong, counted once main is jumped back to
+static volatile long g_sigjmp_round_trips = 0;
+
+/* State of the sigsetjmp/siglongjmp ping-pong */
+static sigjmp_buf g_main_env;
+static sigjmp_buf g_peer_env;
+
+/* State of the context_switch ping-pong */
+static context g_main_ctx;
+static context g_peer_ctx;
+
+/* State of the uthread_yield ping-pong - Whether each switch re-arms the timer */
+static volatile bool g_rearm_timer = false;
+
+static void sigjmp_peer()
+{
+	while (true)
+	{
+		if (0 == sigsetjmp(g_peer_env, 1))
+		{
+			siglongjmp(g_main_env, 1);
+		}
+	}
+}
+
+/*
+ * Jumps to the peer and back - The frame of the loop has no sigsetjmp of its own, so its locals
+ * are never modified between a sigsetjmp and the siglongjmp back to it
+ */
+static __attribute__((noinline)) void sigjmp_round_trip()
+{
+	if (0 == sigsetjmp(g_main_env, 1))
+	{
+		siglongjmp(g_peer_env, 1);
+	}
+	const long round_trips = g_sigjmp_round_trips;
+	g_sigjmp_round_trips = round_trips + 1;
+}
+
+/* Bootstraps the peer for the sigsetjmp ping-pong on its own stack, as done with makecontext */
+static void sigjmp_peer_start(void*)
+{
+	sigjmp_peer();
+}
+
+static void context_peer(void*)
+{
+	while (true)
+	{
+		context_switch(&g_peer_ctx, &g_main_ctx);
+	}
+}
+
+/* Re-arms the timer for a whole quantum, as the library did on every switch which wasn't a preemption */
+static void rearm_timer()
+{
+	struct itimerval timer = {};
+	timer.it_value.tv_usec = quantum_usecs;
+	timer.it_interval = timer.it_value;
+	(void)setitimer(ITIMER_VIRTUAL, &timer, nullptr);
+}
+
+static void yield_peer()
+{
+	while (true)
+	{
+		uthread_yield();
+		if (g_rearm_timer)
+		{
+			rearm_timer();
+		}
+	}
+}
+
+/* Returns the average round trip (two switches) in nanoseconds */
+static double bench_sigjmp(char* stack)
+{
+	// The peer is started with context_switch, from then on only sigsetjmp/siglongjmp are used
+	context bootstrap_ctx;
+	context_init(&g_peer_ctx, stack, bench_stack_size, sigjmp_peer_start, nullptr);
+	if (0 == sigsetjmp(g_main_env, 1))
+	{
+		context_switch(&bootstrap_ctx, &g_peer_ctx);
+	}
+
+	g_sigjmp_round_trips = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < g_iterations; i++)
+	{
+		sigjmp_round_trip();
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	if (g_iterations != g_sigjmp_round_trips)
+	{
+		std::cerr << "sigsetjmp ping-pong completed " << g_sigjmp_round_trips << " of " << g_iterations
+				  << " round trips" << std::endl;
+	}
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / g_iterations;
+}
+
+static double bench_context_switch(char* stack)
+{
+	context_init(&g_peer_ctx, stack, bench_stack_size, context_peer, nullptr);
+	context_switch(&g_main_ctx, &g_peer_ctx);
+
+	const auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < g_iterations; i++)
+	{
+		context_switch(&g_main_ctx, &g_peer_ctx);
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / g_iterations;
+}
+
+/* Yields to the peer thread and back, the library must be initialized with the peer spawned */
+static double bench_yield(bool rearm)
+{
+	g_rearm_timer = rearm;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < g_iterations; i++)
+	{
+		uthread_yield();
+		if (rearm)
+		{
+			rearm_timer();
+		}
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / g_iterations;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+	{
+		g_iterations = std::atol(argv[1]);
+		if (g_iterations <= 0)
+		{
+			std::cerr << "usage: " << argv[0] << " [iterations]" << std::endl;
+			return 1;
+		}
+	}
+
+	char* sigjmp_stack = new char[bench_stack_size];
+	char* context_stack = new char[bench_stack_size];
+
+	const double sigjmp_ns = bench_sigjmp(sigjmp_stack);
+	const double context_ns = bench_context_switch(context_stack);
+
+	if ((0 != uthread_init(quantum_usecs)) || (-1 == uthread_spawn(yield_peer)))
+	{
+		return 1;
+	}
+	const double rearm_yield_ns = bench_yield(true);
+	const double yield_ns = bench_yield(false);
+
+	std::cout << "iterations: " << g_iterations << std::endl;
+	std::cout << "sigsetjmp/siglongjmp round trip: " << sigjmp_ns << " ns" << std::endl;
+	std::cout << "context_switch round trip: " << context_ns << " ns" << std::endl;
+	std::cout << "uthread_yield round trip, re-arming the timer: " << rearm_yield_ns << " ns" << std::endl;
+	std::cout << "uthread_yield round trip: " << yield_ns << " ns" << std::endl;
+
+	delete[] sigjmp_stack;
+	delete[] context_stack;
+
+	// Terminating the main thread exits the process, along with the peer thread
+	uthread_terminate(0);
+	return 0;
+}
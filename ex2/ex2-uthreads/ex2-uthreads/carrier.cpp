@@ -0,0 +1,97 @@
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "carrier.h"
+
+constexpr size_t idle_stack_size = 64 * 1024;
+constexpr int usec_threshold = 1000000;
+
+carrier::carrier(int index, sched_policy* policy) :
+	index(index),
+	lock(),
+	holds_global(false),
+	handoff_lock(nullptr),
+	quantums(0),
+	quantum_start_tsc(0),
+	policy(policy),
+	pthread(pthread_self()),
+	running(nullptr),
+	idle_ctx(),
+	kicked(false),
+	in_library(0),
+	preempt_pending(false),
+	m_has_timer(false),
+	m_timer(),
+	m_timer_armed(false),
+	m_idle_stack(nullptr)
+{}
+
+carrier::~carrier()
+{
+	if (m_has_timer)
+	{
+		(void)timer_delete(m_timer);
+	}
+
+	delete[] m_idle_stack;
+}
+
+void carrier::create_idle_context(context_entry_point idle_loop)
+{
+	m_idle_stack = new char[idle_stack_size];
+	context_init(&idle_ctx, m_idle_stack, idle_stack_size, idle_loop, this);
+}
+
+bool carrier::create_timer(clockid_t clock)
+{
+	struct sigevent event = {};
+	event.sigev_notify = SIGEV_THREAD_ID;
+	event.sigev_signo = SIGVTALRM;
+	event._sigev_un._tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+	if (-1 == timer_create(clock, &event, &m_timer))
+	{
+		return false;
+	}
+
+	pthread = pthread_self();
+	m_has_timer = true;
+	return true;
+}
+
+bool carrier::reset_timer(int usecs)
+{
+	return reset_timer(usecs, usecs);
+}
+
+bool carrier::reset_timer(int usecs, int first_usecs)
+{
+	m_timer_armed = (0 != usecs);
+
+	if (!m_has_timer)
+	{
+		struct itimerval timer = {};
+		timer.it_value.tv_sec = first_usecs / usec_threshold;
+		timer.it_value.tv_usec = first_usecs % usec_threshold;
+		timer.it_interval.tv_sec = usecs / usec_threshold;
+		timer.it_interval.tv_usec = usecs % usec_threshold;
+
+		return (0 == setitimer(ITIMER_VIRTUAL, &timer, nullptr));
+	}
+
+	struct itimerspec timer = {};
+	timer.it_value.tv_sec = first_usecs / usec_threshold;
+	timer.it_value.tv_nsec = (first_usecs % usec_threshold) * 1000L;
+	timer.it_interval.tv_sec = usecs / usec_threshold;
+	timer.it_interval.tv_nsec = (usecs % usec_threshold) * 1000L;
+
+	return (0 == timer_settime(m_timer, 0, &timer, nullptr));
+}
+
+bool carrier::stop_timer()
+{
+	// A zero interval disarms both kinds of timers
+	return reset_timer(0);
+}
@@ -0,0 +1,101 @@
+#ifndef CARRIER_H
+#define CARRIER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+#include <time.h>
+
+#include "context.h"
+#include "sched_policy.h"
+#include "spinlock.h"
+#include "thread.h"
+
+/*
+ * A kernel thread which user threads run on. The first carrier is the thread which initialized
+ * the library, the others are pthreads created on initialization.
+ * Each carrier has its own ready threads (kept by its own policy instance), and its own
+ * preemption timer. Once a carrier has no ready thread left, it steals from the other carriers,
+ * or waits in its idle loop until there are.
+ */
+class carrier
+{
+public:
+	carrier(int index, sched_policy* policy);
+	~carrier();
+
+	carrier(const carrier&) = delete;
+	carrier& operator=(const carrier&) = delete;
+
+	/**
+	 * @brief Sets up the idle context to run the idle loop on a stack of its own.
+	 * Required only for the first carrier, the others run the idle loop on their own stack.
+	 */
+	void create_idle_context(context_entry_point idle_loop);
+
+	/**
+	 * @brief Creates a timer on the given clock (e.g. CLOCK_THREAD_CPUTIME_ID for the CPU time of the calling
+	 * thread, or CLOCK_MONOTONIC for real time), which signals only the calling thread.
+	 * Without it, the carrier uses the process-wide virtual timer (ITIMER_VIRTUAL).
+	 * @return Whether the timer was created.
+	 */
+	bool create_timer(clockid_t clock);
+
+	/**
+	 * @brief Restarts the preemption timer, expiring every usecs microseconds.
+	 * May be called by other carriers, unless the carrier uses the process-wide virtual timer.
+	 * @return Whether the timer was set.
+	 */
+	bool reset_timer(int usecs);
+
+	/**
+	 * @brief Restarts the preemption timer, expiring first in first_usecs microseconds and every usecs
+	 * microseconds from then on - As reset_timer.
+	 * @return Whether the timer was set.
+	 */
+	bool reset_timer(int usecs, int first_usecs);
+
+	/**
+	 * @brief Disarms the preemption timer, until it is restarted.
+	 * @return Whether the timer was disarmed.
+	 */
+	bool stop_timer();
+
+	bool timer_armed() const { return m_timer_armed; }
+
+	const int index;
+	// Guarding the carrier's ready threads (its policy), its running thread and its timer, along with the scheduling
+	// state of the threads READY or RUNNING on it - Held across context switches, like the manager's lock
+	spinlock lock;
+	// Whether the manager's lock is held along with the carrier's lock, so it is released along with it
+	bool holds_global;
+	// The lock of what the thread switched out last waits on (see object_lock), held across the switch like the
+	// carrier's lock and released along with it - Or nullptr
+	spinlock* handoff_lock;
+	// The quantums started on the carrier, the total quantums are those of all the carriers
+	std::atomic<int> quantums;
+	// The timestamp counter (see read_tsc) the running quantum has started at - The timer isn't reset as a quantum
+	// starts by a switch, so its expiry is checked against it (see sigvtalrm_handler)
+	uint64_t quantum_start_tsc;
+	const std::unique_ptr<sched_policy> policy;
+	pthread_t pthread;
+	// The thread running on the carrier, or nullptr if the carrier is in its idle loop
+	thread* running;
+	// The context of the carrier's idle loop
+	context idle_ctx;
+	// Set when another carrier asks this carrier to reschedule its running thread
+	std::atomic<bool> kicked;
+	// Non-zero while the carrier runs library code, which the timer signal must not interrupt - The signal only
+	// sets preempt_pending then, and the preemption is taken once the library code is done
+	std::atomic<int> in_library;
+	std::atomic<bool> preempt_pending;
+
+private:
+	bool m_has_timer;
+	timer_t m_timer;
+	bool m_timer_armed;
+	char* m_idle_stack;
+};
+
+#endif // CARRIER_H
@@ -0,0 +1,112 @@
+#include <algorithm>
+
+#include "cfs_policy.h"
+#include "trace.h"
+
+/* Returns the virtual runtime of running for the cycles, by the weight */
+static uint64_t weighted_cycles(uint64_t cycles, int weight)
+{
+	return cycles * DEFAULT_WEIGHT / static_cast<uint64_t>(weight);
+}
+
+cfs_policy::cfs_policy() :
+	m_ready(&thread::sched_vruntime),
+	m_min_vruntime(0),
+	m_skip(nullptr)
+{}
+
+void cfs_policy::enqueue(thread* t, ready_reason reason)
+{
+	charge(t, t->run_cycles);
+
+	switch (reason)
+	{
+	case READY_SPAWNED:
+	case READY_WOKEN:
+		place(t);
+		break;
+	case READY_YIELDED:
+		// Raising the virtual runtime would hold the thread back for as long as the threads ahead of it
+		// have run (by their weights), so it is only skipped once
+		m_skip = t;
+		break;
+	case READY_PREEMPTED:
+		break;
+	}
+
+	m_ready.insert(t);
+}
+
+void cfs_policy::remove(thread* t)
+{
+	if (m_skip == t)
+	{
+		m_skip = nullptr;
+	}
+	m_ready.remove(t);
+}
+
+thread* cfs_policy::dequeue_next()
+{
+	if (m_ready.empty())
+	{
+		return nullptr;
+	}
+
+	thread* t = m_ready.front();
+	if ((m_skip == t) && (nullptr != m_ready.next(t)))
+	{
+		t = m_ready.next(t);
+	}
+	m_skip = nullptr;
+
+	m_ready.remove(t);
+	return t;
+}
+
+bool cfs_policy::empty() const
+{
+	return m_ready.empty();
+}
+
+void cfs_policy::dispatch(thread* t)
+{
+	// A thread switched to directly may be ahead of the first ready thread, which is the minimum then
+	uint64_t vruntime = t->sched_vruntime;
+	if (!m_ready.empty())
+	{
+		vruntime = std::min(vruntime, m_ready.front()->sched_vruntime);
+	}
+	m_min_vruntime = std::max(m_min_vruntime, vruntime);
+}
+
+void cfs_policy::adopt(thread* t)
+{
+	// The virtual runtimes of the other carrier's policy aren't comparable to the ones here
+	place(t);
+}
+
+bool cfs_policy::tick(thread* running)
+{
+	// The running thread alone starts a new quantum on each tick, as with the other policies
+	if (m_ready.empty())
+	{
+		return true;
+	}
+
+	const uint64_t run_cycles = running->run_cycles + (read_tsc() - running->run_start_tsc);
+	const uint64_t vruntime = running->sched_vruntime +
+							  weighted_cycles(run_cycles - running->sched_charged_cycles, running->sched_weight);
+	return vruntime > m_ready.front()->sched_vruntime;
+}
+
+void cfs_policy::charge(thread* t, uint64_t run_cycles)
+{
+	t->sched_vruntime += weighted_cycles(run_cycles - t->sched_charged_cycles, t->sched_weight);
+	t->sched_charged_cycles = run_cycles;
+}
+
+void cfs_policy::place(thread* t)
+{
+	t->sched_vruntime = std::max(t->sched_vruntime, m_min_vruntime);
+}
@@ -0,0 +1,53 @@
+#ifndef CFS_POLICY_H
+#define CFS_POLICY_H
+
+#include <cstdint>
+
+#include "sched_policy.h"
+#include "thread_tree.h"
+
+/*
+ * Fair-share scheduling (as the Completely Fair Scheduler) -
+ * Each thread has a virtual runtime, the cycles it has run for (see thread::run_cycles) scaled down by its
+ * weight, and the ready thread with the lowest virtual runtime runs next.
+ * - The running thread is preempted on the tick its virtual runtime passes that of the first ready thread,
+ *   so threads which block or sleep in the middle of quantums are paid back for the rest of them.
+ * - A thread which becomes ready (spawned, woken up, or moved from another carrier) starts at no lower
+ *   than the policy's minimum virtual runtime, so it doesn't run for the time it wasn't ready.
+ * - A yielding thread keeps its virtual runtime, and is passed over by the next pick if any other thread is ready
+ *   (as the skip buddy of the Completely Fair Scheduler) - So it neither runs right away again, nor is it held
+ *   back behind threads which are far ahead of it.
+ * Priorities are ignored.
+ */
+class cfs_policy : public sched_policy
+{
+public:
+	cfs_policy();
+
+	void enqueue(thread* t, ready_reason reason) override;
+	void remove(thread* t) override;
+	thread* dequeue_next() override;
+	bool empty() const override;
+	void dispatch(thread* t) override;
+	void adopt(thread* t) override;
+	bool tick(thread* running) override;
+
+	/**
+	 * @brief Adds the cycles the thread has run for since it was last charged to its virtual runtime, by its
+	 * current weight - 'run_cycles' is the total the thread has run for (including its running quantum, if any).
+	 * The thread must not be queued.
+	 */
+	static void charge(thread* t, uint64_t run_cycles);
+
+private:
+	// Raises the virtual runtime of the thread to the policy's minimum, if it is lower
+	void place(thread* t);
+
+	thread_tree m_ready;
+	// The virtual runtime of the first thread to run, never decreasing
+	uint64_t m_min_vruntime;
+	// The thread which has yielded, passed over by the next pick (nullptr if none)
+	thread* m_skip;
+};
+
+#endif // CFS_POLICY_H
@@ -0,0 +1,90 @@
+/*
+ * Test of yielding under UTHREAD_SCHED_CFS, among busy threads of mixed weights.
+ * The main thread yields in a loop on a single carrier, while threads of a much lower and a much higher
+ * weight than its own run without ever yielding. Each yield must return within a few quantums -
+ * A yield which lets the threads far ahead of the yielder (e.g. of a low weight) hold it back fails.
+ * Exits with 0 if every yield returned in time and every thread got to run, 1 otherwise.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "uthreads.h"
+
+constexpr int quantum_usecs = 10000;
+constexpr int test_millis = 1000;
+// The latest a yield may return, in quantums - Each of the busy threads may run a quantum first
+constexpr int max_yield_quantums = 10;
+
+constexpr int busy_weights[] = { 1, DEFAULT_WEIGHT, 4 * DEFAULT_WEIGHT };
+constexpr int busy_count = sizeof(busy_weights) / sizeof(busy_weights[0]);
+
+using test_clock = std::chrono::steady_clock;
+
+static volatile bool g_stop = false;
+static volatile long g_busy_loops[busy_count] = {};
+
+static void busy_thread(int index)
+{
+	while (!g_stop)
+	{
+		g_busy_loops[index] = g_busy_loops[index] + 1;
+	}
+	uthread_terminate(uthread_get_tid());
+}
+
+static void busy_thread_0() { busy_thread(0); }
+static void busy_thread_1() { busy_thread(1); }
+static void busy_thread_2() { busy_thread(2); }
+
+int main()
+{
+	if (-1 == uthread_init_sched(quantum_usecs, UTHREAD_SCHED_CFS))
+	{
+		return 1;
+	}
+
+	const thread_entry_point busy_threads[busy_count] = { busy_thread_0, busy_thread_1, busy_thread_2 };
+	for (int i = 0; i < busy_count; i++)
+	{
+		const int tid = uthread_spawn(busy_threads[i]);
+		if ((-1 == tid) || (-1 == uthread_set_weight(tid, busy_weights[i])))
+		{
+			return 1;
+		}
+	}
+
+	const auto start = test_clock::now();
+	auto last = start;
+	long yields = 0;
+	long long max_yield_us = 0;
+	while (last - start < std::chrono::milliseconds(test_millis))
+	{
+		uthread_yield();
+		const auto now = test_clock::now();
+		max_yield_us = std::max<long long>(max_yield_us,
+										   std::chrono::duration_cast<std::chrono::microseconds>(now - last).count());
+		last = now;
+		yields++;
+	}
+	g_stop = true;
+
+	bool passed = max_yield_us <= static_cast<long long>(max_yield_quantums) * quantum_usecs;
+	std::cout << "yields: " << yields << ", longest yield: " << max_yield_us << " us" << std::endl;
+	for (int i = 0; i < busy_count; i++)
+	{
+		std::cout << "weight " << busy_weights[i] << ": " << g_busy_loops[i] << " loops" << std::endl;
+		passed = passed && (0 != g_busy_loops[i]);
+	}
+
+	std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+	if (!passed)
+	{
+		return 1;
+	}
+
+	uthread_terminate(0);
+	return 0;
+}
@@ -0,0 +1,206 @@
+// Jumping to another stack is valid here, but the fortified siglongjmp takes any jump to a lower
+// stack address for a jump into a frame which has returned
+#undef _FORTIFY_SOURCE
+
+#include <cstdint>
+
+#include "context.h"
+
+#ifndef CONTEXT_X86_64
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#ifdef CONTEXT_X86_64
+/* code for 64 bit Intel arch */
+
+extern "C" void context_switch_asm(void** from_sp, void* const* to_sp);
+extern "C" void context_start_asm();
+
+/*
+ * Saves the callee-saved registers (and the x87/SSE control words) on the current stack,
+ * stores the stack pointer in *from_sp, and restores the same from *to_sp.
+ * *to_sp is read only after *from_sp is written, so switching a context to itself is valid.
+ * The return address on the restored stack is where the other context continues from.
+ *
+ * A new context starts at context_start_asm, with the entry point in rbx and its argument
+ * in r12 (as set up by context_init), and the stack aligned as if it was just called.
+ */
+asm(
+	".text\n"
+	".globl context_switch_asm\n"
+	".type context_switch_asm, @function\n"
+	"context_switch_asm:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $16, %rsp\n"
+	"	stmxcsr 8(%rsp)\n"
+	"	fnstcw (%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq (%rsi), %rsp\n"
+	"	fldcw (%rsp)\n"
+	"	ldmxcsr 8(%rsp)\n"
+	"	addq $16, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".size context_switch_asm, .-context_switch_asm\n"
+	"\n"
+	".globl context_start_asm\n"
+	".type context_start_asm, @function\n"
+	"context_start_asm:\n"
+	"	movq %r12, %rdi\n"
+	"	callq *%rbx\n"
+	"	ud2\n"
+	".size context_start_asm, .-context_start_asm\n"
+);
+
+// Initial control words, as set by the ABI on process startup
+constexpr uint64_t initial_mxcsr = 0x1F80;
+constexpr uint64_t initial_fpu_cw = 0x037F;
+
+void context_init(context* ctx, char* stack, size_t stack_size, context_entry_point entry, void* arg)
+{
+	// The initial frame, from the lowest address - FPU control word, MXCSR, r15, r14, r13,
+	// r12, rbx, rbp, and the return address. Once it is popped, the stack must be
+	// 16-byte aligned so the entry point is called with the alignment the ABI requires.
+	const uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + stack_size) & ~static_cast<uintptr_t>(0xF);
+	uint64_t* frame = reinterpret_cast<uint64_t*>(top) - 9;
+
+	frame[0] = initial_fpu_cw;
+	frame[1] = initial_mxcsr;
+	frame[2] = 0; // r15
+	frame[3] = 0; // r14
+	frame[4] = 0; // r13
+	frame[5] = reinterpret_cast<uint64_t>(arg); // r12
+	frame[6] = reinterpret_cast<uint64_t>(entry); // rbx
+	frame[7] = 0; // rbp
+	frame[8] = reinterpret_cast<uint64_t>(context_start_asm);
+
+	ctx->sp = frame;
+}
+
+void context_switch(context* from, context* to)
+{
+	context_switch_asm(&from->sp, &to->sp);
+}
+
+#else
+/*
+ * Portable fallback, for any POSIX system - sigsetjmp/siglongjmp without the signal mask.
+ * The layout of a jump buffer isn't known, so a new context can't be set up by writing its stack pointer.
+ * Instead, a signal is delivered on the new stack (as an alternate signal stack), and its handler saves
+ * a jump buffer there and returns. Jumping to it later runs on the new stack, outside of any signal
+ * handler, where the context's own jump buffer is saved (as done by GNU Pth).
+ * The signal frame the kernel leaves at the top of the stack is taken from the context's stack.
+ */
+
+// Delivered only while a context is initialized, with the handler of the application restored afterwards
+constexpr int bootstrap_signal = SIGUSR2;
+
+// A single context is initialized at a time, since the signal handler is process wide
+static std::mutex g_init_mutex;
+
+// The context being initialized, its jump buffer on the new stack, and the one to return to context_init
+static context* g_init_ctx = nullptr;
+static sigjmp_buf g_init_trampoline;
+static sigjmp_buf g_init_caller;
+
+// The context being switched to, read by a starting context to find its entry point
+static thread_local context* g_starting_context = nullptr;
+
+/* Runs on the new stack once jumped to from context_init, saves the context's jump buffer */
+static void context_bootstrap()
+{
+	if (0 == sigsetjmp(g_init_ctx->env, 0))
+	{
+		siglongjmp(g_init_caller, 1);
+	}
+
+	// Switched to for the first time
+	context* ctx = g_starting_context;
+	ctx->entry(ctx->arg);
+}
+
+/* The bootstrap signal handler, runs on the new stack */
+static void context_trampoline(int)
+{
+	if (0 == sigsetjmp(g_init_trampoline, 0))
+	{
+		return;
+	}
+
+	context_bootstrap();
+}
+
+void context_init(context* ctx, char* stack, size_t stack_size, context_entry_point entry, void* arg)
+{
+	ctx->entry = entry;
+	ctx->arg = arg;
+
+	std::lock_guard<std::mutex> guard(g_init_mutex);
+	g_init_ctx = ctx;
+
+	// No other signal may be handled on the new stack, or switch contexts in the middle
+	sigset_t bootstrap_mask;
+	sigset_t old_mask;
+	(void)sigfillset(&bootstrap_mask);
+	(void)sigdelset(&bootstrap_mask, bootstrap_signal);
+	(void)pthread_sigmask(SIG_SETMASK, &bootstrap_mask, &old_mask);
+
+	struct sigaction trampoline_action = {};
+	struct sigaction old_action = {};
+	trampoline_action.sa_handler = context_trampoline;
+	trampoline_action.sa_flags = SA_ONSTACK;
+	(void)sigemptyset(&trampoline_action.sa_mask);
+
+	stack_t new_stack = {};
+	stack_t old_stack = {};
+	new_stack.ss_sp = stack;
+	new_stack.ss_size = stack_size;
+	new_stack.ss_flags = 0;
+
+	if ((0 != sigaction(bootstrap_signal, &trampoline_action, &old_action)) ||
+		(0 != sigaltstack(&new_stack, &old_stack)))
+	{
+		std::cerr << "system error: setting up a context failed" << std::endl;
+		exit(1);
+	}
+
+	// The handler runs before raise returns, as the signal is sent to the calling thread and unblocked
+	(void)raise(bootstrap_signal);
+
+	// The new stack mustn't be an alternate signal stack once it is jumped to
+	(void)sigaltstack(&old_stack, nullptr);
+	(void)sigaction(bootstrap_signal, &old_action, nullptr);
+
+	if (0 == sigsetjmp(g_init_caller, 0))
+	{
+		siglongjmp(g_init_trampoline, 1);
+	}
+
+	(void)pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+}
+
+void context_switch(context* from, context* to)
+{
+	// Not saving the signal mask, so no system calls are involved
+	if (0 == sigsetjmp(from->env, 0))
+	{
+		g_starting_context = to;
+		siglongjmp(to->env, 1);
+	}
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <cstddef>
+#include <setjmp.h>
+
+// The portable fallback may be forced on x86-64 as well (e.g. to test it), by defining UTHREADS_PORTABLE_CONTEXT
+#if defined(__x86_64__) && !defined(UTHREADS_PORTABLE_CONTEXT)
+#define CONTEXT_X86_64
+#endif
+
+/* Entry point of a context, receives the argument given on initialization */
+using context_entry_point = void (*)(void*);
+
+/*
+ * The execution context of a user thread - Only the registers a function call
+ * has to preserve (callee-saved registers, stack pointer and FPU control words).
+ * Unlike sigsetjmp/siglongjmp, switching contexts does not save or restore the
+ * signal mask, so it involves no system calls. Signal masking is up to the scheduler.
+ */
+struct context
+{
+#ifdef CONTEXT_X86_64
+	// The callee-saved registers are pushed to the context's own stack,
+	// only the stack pointer is kept aside
+	void* sp;
+#else
+	// Portable fallback - A jump buffer which doesn't save the signal mask, and the entry point
+	// to call once the context is first switched to
+	sigjmp_buf env;
+	context_entry_point entry;
+	void* arg;
+#endif
+};
+
+/**
+ * @brief Prepares a context to run entry(arg) on the given stack, once switched to.
+ * The entry point must never return.
+ */
+void context_init(context* ctx, char* stack, size_t stack_size, context_entry_point entry, void* arg);
+
+/**
+ * @brief Saves the current context to 'from' and resumes the context 'to'.
+ * Returns once another context switches back to 'from'.
+ */
+void context_switch(context* from, context* to);
+
+#endif // CONTEXT_H
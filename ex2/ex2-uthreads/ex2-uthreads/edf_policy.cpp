@@ -0,0 +1,86 @@
+#include <utility>
+
+#include "edf_policy.h"
+#include "trace.h"
+
+edf_policy::edf_policy(std::unique_ptr<sched_policy> normal) :
+	m_ready(&thread::rt_deadline),
+	m_normal(std::move(normal))
+{}
+
+void edf_policy::enqueue(thread* t, ready_reason reason)
+{
+	if (is_realtime(t))
+	{
+		m_ready.insert(t);
+		return;
+	}
+
+	m_normal->enqueue(t, reason);
+}
+
+void edf_policy::remove(thread* t)
+{
+	// The class of a queued thread doesn't change, see uthread_set_periodic
+	if (is_realtime(t))
+	{
+		m_ready.remove(t);
+		return;
+	}
+
+	m_normal->remove(t);
+}
+
+thread* edf_policy::dequeue_next()
+{
+	return m_ready.empty() ? m_normal->dequeue_next() : m_ready.pop_front();
+}
+
+bool edf_policy::empty() const
+{
+	return m_ready.empty() && m_normal->empty();
+}
+
+void edf_policy::dispatch(thread* t)
+{
+	// Real-time threads start a quantum of the normal policy as well, so a thread which becomes a normal thread
+	// while it runs (throttled, or no longer periodic) is ticked by it as any other
+	m_normal->dispatch(t);
+}
+
+void edf_policy::adopt(thread* t)
+{
+	if (!is_realtime(t))
+	{
+		m_normal->adopt(t);
+	}
+}
+
+bool edf_policy::tick(thread* running)
+{
+	// The real-time threads run ahead of the normal ones
+	if (!is_realtime(running))
+	{
+		return !m_ready.empty() || m_normal->tick(running);
+	}
+
+	const uint64_t run_cycles = running->run_cycles + (read_tsc() - running->run_start_tsc);
+	if (run_cycles - running->rt_job_start_cycles >= running->rt_budget_cycles)
+	{
+		running->rt_throttled = true;
+		return true;
+	}
+
+	// Running on unless a job of an earlier deadline is ready - A thread running alone starts a new quantum
+	// on each tick, as with the other policies
+	if (!m_ready.empty())
+	{
+		return m_ready.front()->rt_deadline < running->rt_deadline;
+	}
+	return m_normal->empty();
+}
+
+bool edf_policy::is_realtime(const thread* t)
+{
+	return (0 != t->rt_period_ns) && !t->rt_throttled;
+}
@@ -0,0 +1,43 @@
+#ifndef EDF_POLICY_H
+#define EDF_POLICY_H
+
+#include <memory>
+
+#include "sched_policy.h"
+#include "thread_tree.h"
+
+/*
+ * Earliest Deadline First scheduling of the real-time (periodic) threads, ahead of the normal threads -
+ * The normal threads are scheduled by another policy (the default class), run only while no real-time
+ * thread is ready.
+ * - The ready real-time thread whose job has the earliest deadline runs first, and it is preempted on the
+ *   next tick once a thread of an earlier deadline is ready.
+ * - A normal thread is preempted on the next tick once a real-time thread is ready.
+ * - A job which has run for its whole budget is throttled - Its thread runs as a normal thread until its next
+ *   period, so it doesn't take the time admitted for the others.
+ */
+class edf_policy : public sched_policy
+{
+public:
+	explicit edf_policy(std::unique_ptr<sched_policy> normal);
+
+	void enqueue(thread* t, ready_reason reason) override;
+	void remove(thread* t) override;
+	thread* dequeue_next() override;
+	bool empty() const override;
+	void dispatch(thread* t) override;
+	void adopt(thread* t) override;
+	bool tick(thread* running) override;
+
+	/**
+	 * @brief Returns whether the thread is scheduled as a real-time thread - It is periodic, and its current
+	 * job isn't throttled.
+	 */
+	static bool is_realtime(const thread* t);
+
+private:
+	thread_tree m_ready;
+	const std::unique_ptr<sched_policy> m_normal;
+};
+
+#endif // EDF_POLICY_H
@@ -0,0 +1,151 @@
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "io_poller.h"
+
+io_poller::io_poller() :
+	lock(),
+	m_epoll_fd(-1),
+	m_wake_fd(-1),
+	m_fds(),
+	m_waiter_count(0)
+{}
+
+io_poller::~io_poller()
+{
+	if (-1 != m_wake_fd)
+	{
+		(void)close(m_wake_fd);
+	}
+
+	if (-1 != m_epoll_fd)
+	{
+		(void)close(m_epoll_fd);
+	}
+}
+
+bool io_poller::create()
+{
+	m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (-1 == m_epoll_fd)
+	{
+		return false;
+	}
+
+	m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (-1 == m_wake_fd)
+	{
+		return false;
+	}
+
+	struct epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.fd = m_wake_fd;
+	return 0 == epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event);
+}
+
+int io_poller::add(thread* t)
+{
+	const bool reads = 0 != (t->io_events & EPOLLIN);
+	const bool writes = 0 != (t->io_events & EPOLLOUT);
+	auto registered = m_fds.find(t->io_fd);
+	if ((m_fds.end() != registered) &&
+		((reads && (nullptr != registered->second.reader)) || (writes && (nullptr != registered->second.writer))))
+	{
+		return EEXIST;
+	}
+
+	if (m_fds.end() == registered)
+	{
+		registered = m_fds.emplace(t->io_fd, fd_state{ nullptr, nullptr, 0 }).first;
+	}
+
+	// Re-arming the registration reports the events which are already ready. The fd may have been closed since it
+	// was registered (and its number reused by another), in which case it is registered anew
+	fd_state& state = registered->second;
+	const unsigned int events = state.registered | (t->io_events & (EPOLLIN | EPOLLOUT));
+	struct epoll_event event = {};
+	event.events = events | EPOLLET;
+	event.data.fd = t->io_fd;
+	int result = epoll_ctl(m_epoll_fd, (0 == state.registered) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, t->io_fd, &event);
+	if ((-1 == result) && (ENOENT == errno))
+	{
+		result = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, t->io_fd, &event);
+	}
+	// A duplicate of a closed fd keeps its registration, as long as it is open
+	else if ((-1 == result) && (EEXIST == errno))
+	{
+		result = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, t->io_fd, &event);
+	}
+	if (-1 == result)
+	{
+		const int error = errno;
+		if ((nullptr == state.reader) && (nullptr == state.writer))
+		{
+			m_fds.erase(registered);
+		}
+		return error;
+	}
+	state.registered = events;
+
+	if (reads)
+	{
+		state.reader = t;
+	}
+	if (writes)
+	{
+		state.writer = t;
+	}
+	m_waiter_count.fetch_add(1, std::memory_order_relaxed);
+	return 0;
+}
+
+void io_poller::remove(thread* t)
+{
+	fd_state& state = m_fds.at(t->io_fd);
+	if (t == state.reader)
+	{
+		state.reader = nullptr;
+	}
+	if (t == state.writer)
+	{
+		state.writer = nullptr;
+	}
+	m_waiter_count.fetch_sub(1, std::memory_order_relaxed);
+	t->io_fd = -1;
+}
+
+unsigned int io_poller::take_waiter_events(fd_state& state, thread* t, unsigned int events)
+{
+	// A thread polling for both events is woken up once, as the reader
+	if ((t != state.reader) && (t != state.writer))
+	{
+		return 0;
+	}
+
+	const unsigned int ready = events & (t->io_events | FAILURE_EVENTS);
+	if (0 != ready)
+	{
+		remove(t);
+	}
+	return ready;
+}
+
+int io_poller::wait(epoll_event* events, int max_events, int timeout_ms) const
+{
+	return epoll_wait(m_epoll_fd, events, max_events, timeout_ms);
+}
+
+void io_poller::wake() const
+{
+	const uint64_t value = 1;
+	(void)write(m_wake_fd, &value, sizeof(value));
+}
+
+void io_poller::drain_wake_fd() const
+{
+	uint64_t value = 0;
+	(void)read(m_wake_fd, &value, sizeof(value));
+}
@@ -0,0 +1,133 @@
+#ifndef IO_POLLER_H
+#define IO_POLLER_H
+
+#include <atomic>
+#include <sys/epoll.h>
+#include <unordered_map>
+
+#include "spinlock.h"
+#include "thread.h"
+
+/*
+ * Threads waiting for file descriptors to become ready, registered with an epoll instance.
+ * A thread waits on a single file descriptor (thread::io_fd) at a time, and a file descriptor is waited on by
+ * a single reader and a single writer at a time (a thread polling for both takes both of their places).
+ * A file descriptor stays registered, edge-triggered, for the events it has been waited for. Each wait re-arms its
+ * registration (which reports the events which are already ready, so a thread finding the fd not ready before
+ * it waits misses no edge), and registers it anew if it was closed meanwhile - Possibly reusing its number.
+ * The epoll instance also watches an eventfd, so a carrier waiting in 'wait' can be woken up.
+ * Waiting and has_waiters are safe without any lock, the other functions require the poller's lock - Which is
+ * taken after the carriers' locks, as the lock of a synchronization primitive (see object_lock).
+ */
+class io_poller
+{
+public:
+	io_poller();
+	~io_poller();
+
+	io_poller(const io_poller&) = delete;
+	io_poller& operator=(const io_poller&) = delete;
+
+	/**
+	 * @brief Creates the epoll instance and the eventfd.
+	 * @return Whether they were created.
+	 */
+	bool create();
+
+	/**
+	 * @brief Registers the thread to wait on its io_fd for its io_events (EPOLLIN/EPOLLOUT).
+	 * @return 0 on success, otherwise the errno of the failure - EEXIST if another thread waits on the fd
+	 * for the same events, and EPERM if the fd doesn't support polling (e.g. a regular file, which is always ready).
+	 */
+	int add(thread* t);
+
+	/**
+	 * @brief Removes the registration of the thread before it is woken up.
+	 */
+	void remove(thread* t);
+
+	bool has_waiters() const { return 0 != m_waiter_count.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Waits up to timeout_ms milliseconds (-1 for no timeout) for ready file descriptors,
+	 * or for a call to 'wake'.
+	 * @return The number of events stored, or -1 on failure.
+	 */
+	int wait(epoll_event* events, int max_events, int timeout_ms) const;
+
+	/**
+	 * @brief Removes the registrations of the threads waiting for any of the events, calling 'wake' for each of them
+	 * after storing its ready events in io_events.
+	 */
+	template <typename Func>
+	void dispatch(const epoll_event* events, int count, Func wake);
+
+	/**
+	 * @brief Wakes up a carrier waiting in 'wait'.
+	 */
+	void wake() const;
+
+	// Guarding the registrations, and the threads waiting on them
+	spinlock lock;
+
+private:
+	// Reported by epoll whether they are waited for or not
+	static constexpr unsigned int FAILURE_EVENTS = EPOLLERR | EPOLLHUP;
+
+	struct fd_state
+	{
+		thread* reader;
+		thread* writer;
+		// The events the fd is registered for - Possibly by an fd which has since been closed
+		unsigned int registered;
+	};
+
+	/* Takes the ready events the thread waits for (or none), removing its registration if there are any */
+	unsigned int take_waiter_events(fd_state& state, thread* t, unsigned int events);
+	void drain_wake_fd() const;
+
+	int m_epoll_fd;
+	int m_wake_fd;
+	// The registered fds, and the number of threads waiting on them (read without the lock)
+	std::unordered_map<int, fd_state> m_fds;
+	std::atomic<size_t> m_waiter_count;
+};
+
+template <typename Func>
+void io_poller::dispatch(const epoll_event* events, int count, Func wake)
+{
+	for (int i = 0; i < count; i++)
+	{
+		const int fd = events[i].data.fd;
+		if (m_wake_fd == fd)
+		{
+			drain_wake_fd();
+			continue;
+		}
+
+		auto registered = m_fds.find(fd);
+		if (m_fds.end() == registered)
+		{
+			continue;
+		}
+
+		fd_state& state = registered->second;
+		// The reader is handled first, as a thread polling for both events is also the writer
+		for (thread* const t : { state.reader, state.writer })
+		{
+			if (nullptr == t)
+			{
+				continue;
+			}
+
+			const unsigned int ready = take_waiter_events(state, t, events[i].events);
+			if (0 != ready)
+			{
+				t->io_events = ready;
+				wake(t);
+			}
+		}
+	}
+}
+
+#endif // IO_POLLER_H
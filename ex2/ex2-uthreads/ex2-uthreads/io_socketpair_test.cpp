@@ -0,0 +1,180 @@
+/*
+ * Test of a reader and a writer waiting on the same file descriptor, over a socketpair.
+ * On one end of the socketpair a thread writes far more than the socket buffers hold, while another thread
+ * reads from the same end - So both of them wait on it at once. On the other end a thread drains what was written,
+ * and only then answers with data of its own for the reader. Each direction carries a known byte pattern.
+ * Then the socketpair is closed (by close, which the library isn't told of) and a new one reuses its numbers -
+ * Its reader must wait on the new socket, rather than on what the library knew of the closed one.
+ * Exits with 0 if every byte arrived in order, 1 otherwise. A lost wakeup (or a read blocking its carrier)
+ * leaves a thread waiting forever, so the test fails by timing out.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "uthreads.h"
+
+constexpr int quantum_usecs = 10000;
+constexpr int num_carriers = 2;
+constexpr size_t chunk_size = 64 * 1024;
+// Written from the near end to the far end, and answered from the far end to the near end
+constexpr size_t request_bytes = 16 * 1024 * 1024;
+constexpr size_t response_bytes = 4 * 1024 * 1024;
+// Long enough for the reader of the reused socket to wait on it before the answer is written
+constexpr int answer_delay_usecs = 50000;
+
+static int g_fds[2] = { -1, -1 };
+static volatile bool g_failed = false;
+
+static unsigned char pattern(size_t offset, unsigned char seed)
+{
+	return static_cast<unsigned char>((offset * 7) + seed);
+}
+
+/* Writes 'bytes' bytes of the pattern to the fd, or fails the test */
+static void write_pattern(int fd, size_t bytes, unsigned char seed)
+{
+	unsigned char chunk[chunk_size];
+	size_t written = 0;
+	while (written < bytes)
+	{
+		const size_t count = std::min(chunk_size, bytes - written);
+		for (size_t i = 0; i < count; i++)
+		{
+			chunk[i] = pattern(written + i, seed);
+		}
+
+		const ssize_t result = uthread_write(fd, chunk, count);
+		if (result <= 0)
+		{
+			g_failed = true;
+			return;
+		}
+		written += static_cast<size_t>(result);
+	}
+}
+
+/* Reads 'bytes' bytes from the fd and checks they are the pattern, or fails the test */
+static void read_pattern(int fd, size_t bytes, unsigned char seed)
+{
+	unsigned char chunk[chunk_size];
+	size_t read = 0;
+	while (read < bytes)
+	{
+		const ssize_t result = uthread_read(fd, chunk, std::min(chunk_size, bytes - read));
+		if (result <= 0)
+		{
+			g_failed = true;
+			return;
+		}
+
+		for (ssize_t i = 0; i < result; i++)
+		{
+			if (pattern(read + static_cast<size_t>(i), seed) != chunk[i])
+			{
+				g_failed = true;
+				return;
+			}
+		}
+		read += static_cast<size_t>(result);
+	}
+}
+
+static void* near_writer(void*)
+{
+	write_pattern(g_fds[0], request_bytes, 1);
+	return nullptr;
+}
+
+static void* near_reader(void*)
+{
+	read_pattern(g_fds[0], response_bytes, 2);
+	return nullptr;
+}
+
+static void* far_end(void*)
+{
+	read_pattern(g_fds[1], request_bytes, 1);
+	write_pattern(g_fds[1], response_bytes, 2);
+	return nullptr;
+}
+
+static void* delayed_far_end(void*)
+{
+	uthread_sleep_usecs(answer_delay_usecs);
+	write_pattern(g_fds[1], response_bytes, 3);
+	return nullptr;
+}
+
+static void* reused_near_reader(void*)
+{
+	read_pattern(g_fds[0], response_bytes, 3);
+	return nullptr;
+}
+
+/* Spawns the threads and waits for all of them, returning false on failure */
+static bool run_threads(const thread_entry_point_arg* entry_points, int count)
+{
+	int tids[3] = {};
+	for (int i = 0; i < count; i++)
+	{
+		tids[i] = uthread_spawn_arg(entry_points[i], nullptr);
+		if (-1 == tids[i])
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (-1 == uthread_join(tids[i], nullptr))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	if (-1 == uthread_init_carriers(quantum_usecs, UTHREAD_SCHED_RR, num_carriers))
+	{
+		return 1;
+	}
+
+	if (-1 == socketpair(AF_UNIX, SOCK_STREAM, 0, g_fds))
+	{
+		return 1;
+	}
+
+	// The reader starts first, so it already waits on the near end as the writer fills it up
+	const thread_entry_point_arg entry_points[] = { near_reader, near_writer, far_end };
+	if (!run_threads(entry_points, 3))
+	{
+		return 1;
+	}
+
+	// The lowest free numbers are reused, so the new socketpair takes the numbers of the closed one
+	if ((0 != close(g_fds[0])) || (0 != close(g_fds[1])) || (-1 == socketpair(AF_UNIX, SOCK_STREAM, 0, g_fds)))
+	{
+		return 1;
+	}
+
+	const thread_entry_point_arg reused_entry_points[] = { reused_near_reader, delayed_far_end };
+	if (!run_threads(reused_entry_points, 2))
+	{
+		return 1;
+	}
+
+	const bool passed = !g_failed && (0 == close(g_fds[0])) && (0 == close(g_fds[1]));
+	std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+	if (!passed)
+	{
+		return 1;
+	}
+
+	uthread_terminate(0);
+	return 0;
+}
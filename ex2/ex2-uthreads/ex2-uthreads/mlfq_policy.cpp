@@ -0,0 +1,125 @@
+#include "mlfq_policy.h"
+
+mlfq_policy::mlfq_policy() :
+	m_levels(),
+	m_quantums_since_boost(0),
+	m_boost_epoch(0)
+{}
+
+void mlfq_policy::enqueue(thread* t, ready_reason reason)
+{
+	if (READY_SPAWNED == reason)
+	{
+		t->sched_level = t->priority;
+	}
+	else if (t->sched_epoch != m_boost_epoch)
+	{
+		// A boost took place while the thread was out of the queues
+		t->sched_level = 0;
+	}
+	else if ((READY_PREEMPTED == reason) && (0 == t->sched_ticks) && (t->sched_level < levels - 1))
+	{
+		// The thread has used up its whole quantum
+		t->sched_level++;
+	}
+
+	t->sched_epoch = m_boost_epoch;
+	m_levels[t->sched_level].push_back(t);
+}
+
+void mlfq_policy::remove(thread* t)
+{
+	m_levels[queued_level(t)].unlink(t);
+	apply_boost(t);
+}
+
+thread* mlfq_policy::dequeue_next()
+{
+	const int level = highest_ready_level();
+	if (levels == level)
+	{
+		return nullptr;
+	}
+
+	thread* const t = m_levels[level].pop_front();
+	apply_boost(t);
+	return t;
+}
+
+bool mlfq_policy::empty() const
+{
+	return levels == highest_ready_level();
+}
+
+void mlfq_policy::dispatch(thread* t)
+{
+	apply_boost(t);
+
+	// The quantum of each level is twice as long as the level above it
+	t->sched_ticks = 1 << t->sched_level;
+
+	m_quantums_since_boost++;
+	if (m_quantums_since_boost >= boost_period)
+	{
+		boost();
+	}
+}
+
+void mlfq_policy::adopt(thread* t)
+{
+	// The boosts of the other carrier's policy don't apply here, the thread keeps its level
+	t->sched_epoch = m_boost_epoch;
+}
+
+bool mlfq_policy::tick(thread* running)
+{
+	running->sched_ticks--;
+	if (0 == running->sched_ticks)
+	{
+		return true;
+	}
+
+	// Preempting the thread early if a more urgent thread is waiting
+	return highest_ready_level() < running->sched_level;
+}
+
+void mlfq_policy::boost()
+{
+	m_quantums_since_boost = 0;
+	m_boost_epoch++;
+
+	// The threads are moved as whole queues, so the boost takes the same time however many are queued - Their
+	// level (and epoch) is updated lazily, once they are taken out of the queues (see apply_boost)
+	for (int level = 1; level < levels; level++)
+	{
+		m_levels[0].splice_back(m_levels[level]);
+	}
+}
+
+int mlfq_policy::queued_level(const thread* t) const
+{
+	// Every thread queued before the last boost was moved to the highest level by it
+	return (t->sched_epoch != m_boost_epoch) ? 0 : t->sched_level;
+}
+
+void mlfq_policy::apply_boost(thread* t) const
+{
+	if (t->sched_epoch != m_boost_epoch)
+	{
+		t->sched_level = 0;
+		t->sched_epoch = m_boost_epoch;
+	}
+}
+
+int mlfq_policy::highest_ready_level() const
+{
+	for (int level = 0; level < levels; level++)
+	{
+		if (!m_levels[level].empty())
+		{
+			return level;
+		}
+	}
+
+	return levels;
+}
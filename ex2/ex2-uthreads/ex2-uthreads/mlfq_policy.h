@@ -0,0 +1,51 @@
+#ifndef MLFQ_POLICY_H
+#define MLFQ_POLICY_H
+
+#include "sched_policy.h"
+#include "thread_queue.h"
+
+/*
+ * Multilevel Feedback Queue scheduling -
+ * The threads are queued by priority level (0 being the highest), each level in a FIFO order,
+ * and the highest non-empty level always runs first. The quantum doubles on each level down.
+ * - A thread starts at the level of its priority hint.
+ * - A thread which uses up its whole quantum moves a level down, otherwise it keeps its level.
+ * - Once a thread of a higher level is ready, the running thread is preempted on the next tick.
+ * - Every boost_period quantums, all the threads are moved back to the highest level,
+ *   so CPU-bound threads aren't starved.
+ */
+class mlfq_policy : public sched_policy
+{
+public:
+	mlfq_policy();
+
+	void enqueue(thread* t, ready_reason reason) override;
+	void remove(thread* t) override;
+	thread* dequeue_next() override;
+	bool empty() const override;
+	void dispatch(thread* t) override;
+	void adopt(thread* t) override;
+	bool tick(thread* running) override;
+
+private:
+	static constexpr int levels = PRIORITY_LEVELS;
+	static constexpr int boost_period = 64;
+
+	// Moves all the threads to the highest level
+	void boost();
+	// Returns the level the queued thread is queued on - The highest level if a boost has moved it there
+	int queued_level(const thread* t) const;
+	// Moves the thread to the highest level if a boost took place since it was last queued (or dispatched)
+	void apply_boost(thread* t) const;
+	// Returns the highest non-empty level, or 'levels' if all are empty
+	int highest_ready_level() const;
+
+	thread_queue m_levels[levels];
+	// The number of quantums started since the last boost
+	int m_quantums_since_boost;
+	// Incremented on each boost - Threads which were not queued during a boost (running, blocked or sleeping) are
+	// boosted once queued again, and threads which were queued are boosted once taken out of the queues
+	unsigned int m_boost_epoch;
+};
+
+#endif // MLFQ_POLICY_H
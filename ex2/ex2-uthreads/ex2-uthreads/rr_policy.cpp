@@ -0,0 +1,29 @@
+#include "rr_policy.h"
+
+void rr_policy::enqueue(thread* t, ready_reason /* reason */)
+{
+	m_ready.push_back(t);
+}
+
+void rr_policy::remove(thread* t)
+{
+	m_ready.remove(t);
+}
+
+thread* rr_policy::dequeue_next()
+{
+	return m_ready.empty() ? nullptr : m_ready.pop_front();
+}
+
+bool rr_policy::empty() const
+{
+	return m_ready.empty();
+}
+
+void rr_policy::dispatch(thread* /* t */)
+{}
+
+bool rr_policy::tick(thread* /* running */)
+{
+	return true;
+}
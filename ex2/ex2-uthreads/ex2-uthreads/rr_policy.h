@@ -0,0 +1,27 @@
+#ifndef RR_POLICY_H
+#define RR_POLICY_H
+
+#include "sched_policy.h"
+#include "thread_queue.h"
+
+/*
+ * Round-Robin scheduling - The threads run in a FIFO order, a single tick each.
+ * Priorities are ignored.
+ */
+class rr_policy : public sched_policy
+{
+public:
+	rr_policy() = default;
+
+	void enqueue(thread* t, ready_reason reason) override;
+	void remove(thread* t) override;
+	thread* dequeue_next() override;
+	bool empty() const override;
+	void dispatch(thread* t) override;
+	bool tick(thread* running) override;
+
+private:
+	thread_queue m_ready;
+};
+
+#endif // RR_POLICY_H
@@ -0,0 +1,269 @@
+/*
+ * Benchmark of how the throughput of the library scales with the number of carriers, printed as CSV.
+ * Runs threads_per_carrier threads per carrier, each doing a little work in a loop, for a while - And counts the
+ * operations of all of them per second, with 1, 2, 4, ... carriers (up to the given number). The workloads:
+ * - yield: each thread yields after its work.
+ * - mutex: each thread locks a mutex of its own around its work, and then yields.
+ * - channel: the threads pass items in pairs, each pair over an unbuffered channel of its own (so every
+ *   operation waits, or wakes up the other thread of the pair).
+ * The library can be initialized only once per process, so each number of carriers is measured in a child process.
+ * With more carriers than CPUs the carriers share the CPUs, so the throughput isn't expected to grow beyond them.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "uthreads.h"
+
+constexpr int quantum_usecs = 10000;
+constexpr int default_max_carriers = 8;
+constexpr int max_carriers_limit = 256;
+constexpr int threads_per_carrier = 4;
+constexpr int measure_millis = 1000;
+// The work between yields - So the carriers don't only switch, as the threads of an application wouldn't
+constexpr int work_iterations = 200;
+
+using bench_clock = std::chrono::steady_clock;
+
+enum workload : int
+{
+	WORKLOAD_YIELD,
+	WORKLOAD_MUTEX,
+	WORKLOAD_CHANNEL
+};
+
+constexpr const char* workload_names[] = { "yield", "mutex", "channel" };
+
+// Each thread counts its operations on a cache line of its own, so the counters don't slow down the carriers
+struct alignas(64) op_counter
+{
+	std::atomic<long> ops;
+};
+
+// Indexed by thread ID - The threads of the benchmark take the lowest IDs, and so do their mutexes and channels
+constexpr int max_threads = max_carriers_limit * threads_per_carrier + 2;
+static op_counter g_counters[max_threads];
+static uthread_mutex* g_mutexes[max_threads];
+static uthread_channel* g_channels[max_threads];
+static std::atomic<bool> g_stop(false);
+
+/* Does a little work, returning a value derived from it so it isn't optimized away (though it is never 0) */
+static unsigned int work(unsigned int state)
+{
+	for (int i = 0; i < work_iterations; i++)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+	}
+	return state;
+}
+
+static void count_op(std::atomic<long>& ops, unsigned int state)
+{
+	ops.store(ops.load(std::memory_order_relaxed) + 1 + (0 == state), std::memory_order_relaxed);
+}
+
+static void yielding_thread()
+{
+	std::atomic<long>& ops = g_counters[uthread_get_tid()].ops;
+	unsigned int state = static_cast<unsigned int>(uthread_get_tid());
+	while (!g_stop.load(std::memory_order_relaxed))
+	{
+		state = work(state);
+		count_op(ops, state);
+		uthread_yield();
+	}
+	uthread_terminate(uthread_get_tid());
+}
+
+static void locking_thread()
+{
+	const int tid = uthread_get_tid();
+	std::atomic<long>& ops = g_counters[tid].ops;
+	uthread_mutex* const mutex = g_mutexes[tid];
+	unsigned int state = static_cast<unsigned int>(tid);
+	while (!g_stop.load(std::memory_order_relaxed))
+	{
+		uthread_mutex_lock(mutex);
+		state = work(state);
+		uthread_mutex_unlock(mutex);
+		count_op(ops, state);
+		uthread_yield();
+	}
+	uthread_terminate(uthread_get_tid());
+}
+
+/* The threads of a pair have consecutive IDs, the first sends to the second over the channel of the first */
+static void channel_thread()
+{
+	const int tid = uthread_get_tid();
+	std::atomic<long>& ops = g_counters[tid].ops;
+	const bool sender = (1 == tid % 2);
+	uthread_channel* const channel = g_channels[sender ? tid : tid - 1];
+	unsigned int state = static_cast<unsigned int>(tid);
+	void* item = nullptr;
+	while (!g_stop.load(std::memory_order_relaxed))
+	{
+		state = work(state);
+		if (sender)
+		{
+			uthread_channel_send(channel, nullptr);
+		}
+		else
+		{
+			uthread_channel_recv(channel, &item);
+		}
+		count_op(ops, state);
+	}
+	uthread_terminate(uthread_get_tid());
+}
+
+/* Returns once the measurement is over - The main thread can't sleep, so it waits for this one */
+static void* timer_thread(void* arg)
+{
+	const auto start = bench_clock::now();
+	while (bench_clock::now() - start < std::chrono::milliseconds(measure_millis))
+	{
+		uthread_sleep(1);
+	}
+	return arg;
+}
+
+/*
+ * Measures the operations per second of the workload with the given number of carriers (in a child process),
+ * or returns -1 on failure
+ */
+static double measure(workload load, int carriers)
+{
+	int fds[2] = {};
+	if (-1 == pipe(fds))
+	{
+		return -1;
+	}
+
+	const pid_t pid = fork();
+	if (-1 == pid)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+
+	if (0 == pid)
+	{
+		close(fds[0]);
+		if (-1 == uthread_init_carriers(quantum_usecs, UTHREAD_SCHED_RR, carriers))
+		{
+			_exit(1);
+		}
+
+		// The threads are spawned with the IDs 1, 2, ... (the main thread being 0)
+		const int threads = carriers * threads_per_carrier;
+		for (int tid = 1; tid <= threads; tid++)
+		{
+			g_mutexes[tid] = uthread_mutex_create();
+			g_channels[tid] = uthread_channel_create(0);
+		}
+
+		thread_entry_point entry_point = yielding_thread;
+		if (WORKLOAD_MUTEX == load)
+		{
+			entry_point = locking_thread;
+		}
+		else if (WORKLOAD_CHANNEL == load)
+		{
+			entry_point = channel_thread;
+		}
+
+		for (int i = 0; i < threads; i++)
+		{
+			if (-1 == uthread_spawn(entry_point))
+			{
+				_exit(1);
+			}
+		}
+
+		// The main thread waits for a sleeping thread without running, letting the yielding threads have the carriers
+		const auto start = bench_clock::now();
+		void* result = nullptr;
+		if (-1 == uthread_join(uthread_spawn_arg(timer_thread, nullptr), &result))
+		{
+			_exit(1);
+		}
+
+		long ops = 0;
+		for (const op_counter& counter : g_counters)
+		{
+			ops += counter.ops.load(std::memory_order_relaxed);
+		}
+		const double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+		g_stop = true;
+
+		const double ops_per_sec = ops / seconds;
+		const bool sent = sizeof(ops_per_sec) == write(fds[1], &ops_per_sec, sizeof(ops_per_sec));
+		_exit(sent ? 0 : 1);
+	}
+
+	close(fds[1]);
+	double result = -1;
+	if (sizeof(result) != read(fds[0], &result, sizeof(result)))
+	{
+		result = -1;
+	}
+	close(fds[0]);
+
+	int status = 0;
+	if ((-1 == waitpid(pid, &status, 0)) || !WIFEXITED(status) || (0 != WEXITSTATUS(status)))
+	{
+		return -1;
+	}
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	int max_carriers = default_max_carriers;
+	if (argc > 1)
+	{
+		max_carriers = std::atoi(argv[1]);
+	}
+	if ((max_carriers <= 0) || (max_carriers > max_carriers_limit))
+	{
+		std::cerr << "usage: " << argv[0] << " [max carriers]" << std::endl;
+		return 1;
+	}
+
+	std::cerr << "cpus: " << std::thread::hardware_concurrency() << std::endl;
+	std::cout << "workload,carriers,threads,ops_per_sec,speedup" << std::endl;
+
+	for (const workload load : { WORKLOAD_YIELD, WORKLOAD_MUTEX, WORKLOAD_CHANNEL })
+	{
+		double base = 0;
+		for (int carriers = 1; carriers <= max_carriers; carriers *= 2)
+		{
+			const double ops_per_sec = measure(load, carriers);
+			if (ops_per_sec < 0)
+			{
+				std::cerr << "measuring " << workload_names[load] << " with " << carriers << " carriers failed"
+				          << std::endl;
+				return 1;
+			}
+
+			if (1 == carriers)
+			{
+				base = ops_per_sec;
+			}
+			std::cout << workload_names[load] << "," << carriers << "," << carriers * threads_per_carrier << ","
+			          << static_cast<long long>(ops_per_sec) << "," << ops_per_sec / std::max(base, 1.0) << std::endl;
+		}
+	}
+
+	return 0;
+}
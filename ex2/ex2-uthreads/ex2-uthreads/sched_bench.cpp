@@ -0,0 +1,208 @@
+/*
+ * Benchmark for the scheduling operations of the library, printed as CSV.
+ * Measures each operation separately (so the percentiles show the outliers, not only the mean):
+ * - spawn_terminate: spawning a thread and terminating it before it runs.
+ * - spawn_join: spawning a joinable thread and joining it, as it runs and returns (two switches).
+ * - yield_round_trip: yielding to a thread which yields right back (two switches).
+ * - block_resume_round_trip: resuming a thread and yielding to it, until it blocks itself again.
+ * - sleep_<n>q_late: how much later than n quantums of real time a sleeping thread wakes up,
+ *   while no other thread is READY (so the quantums are counted by the idle carrier).
+ * Every operation is measured with 10, 100, 10000 and 100000 other live threads, all of them BLOCKED.
+ * The stacks have no guard pages, as guarded stacks take two memory mappings each and the kernel's limit on them
+ * (vm.max_map_count) stops spawning at about 32k threads - The benchmark fails if spawning any of the threads fails.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "uthreads.h"
+
+constexpr int quantum_usecs = 10000;
+constexpr long default_samples = 10000;
+constexpr long sleep_samples = 20;
+constexpr int live_thread_counts[] = { 10, 100, 10000, 100000 };
+constexpr int sleep_quantums[] = { 1, 4 };
+
+static long g_samples = default_samples;
+
+static uthread_channel* g_done = nullptr;
+static int g_sleep_quantums = 0;
+static std::vector<long long> g_sleep_late_ns;
+
+using bench_clock = std::chrono::steady_clock;
+
+static long long elapsed_ns(bench_clock::time_point start, bench_clock::time_point end)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static void parked_thread()
+{
+	// The thread is blocked or terminated right after it is spawned - It runs only if the spawning thread
+	// is preempted before that, then it blocks itself
+	uthread_block(uthread_get_tid());
+}
+
+static void* returning_thread(void* arg)
+{
+	return arg;
+}
+
+static void yield_peer()
+{
+	while (true)
+	{
+		uthread_yield();
+	}
+}
+
+static void block_peer()
+{
+	const int tid = uthread_get_tid();
+	while (true)
+	{
+		uthread_block(tid);
+	}
+}
+
+static void sleep_peer()
+{
+	const long long requested_ns = static_cast<long long>(g_sleep_quantums) * quantum_usecs * 1000;
+	for (long i = 0; i < sleep_samples; i++)
+	{
+		const auto start = bench_clock::now();
+		uthread_sleep(g_sleep_quantums);
+		g_sleep_late_ns.push_back(elapsed_ns(start, bench_clock::now()) - requested_ns);
+	}
+
+	uthread_channel_send(g_done, nullptr);
+	uthread_terminate(uthread_get_tid());
+}
+
+/* Prints the CSV row of the samples (which are sorted by it) */
+static void report(const char* benchmark, int live_threads, std::vector<long long>& samples)
+{
+	std::sort(samples.begin(), samples.end());
+	long double sum = 0;
+	for (const long long sample : samples)
+	{
+		sum += sample;
+	}
+
+	// Nearest-rank percentiles
+	auto percentile = [&samples](int p)
+	{
+		const size_t rank = (samples.size() * p + 99) / 100;
+		return samples[std::max<size_t>(rank, 1) - 1];
+	};
+
+	std::cout << benchmark << "," << live_threads << "," << samples.size() << ","
+	          << static_cast<long long>(sum / samples.size()) << "," << percentile(50) << "," << percentile(90) << ","
+	          << percentile(99) << "," << samples.back() << std::endl;
+}
+
+/* Measures each of the samples operations, and reports them */
+template <typename Func>
+static void measure(const char* benchmark, int live_threads, long samples, Func operation)
+{
+	std::vector<long long> results;
+	results.reserve(samples);
+	for (long i = 0; i < samples; i++)
+	{
+		const auto start = bench_clock::now();
+		operation();
+		results.push_back(elapsed_ns(start, bench_clock::now()));
+	}
+
+	report(benchmark, live_threads, results);
+}
+
+static void run_benchmarks(int live_threads)
+{
+	measure("spawn_terminate", live_threads, g_samples, []()
+	{
+		uthread_terminate(uthread_spawn(parked_thread));
+	});
+
+	measure("spawn_join", live_threads, g_samples, []()
+	{
+		void* result = nullptr;
+		uthread_join(uthread_spawn_arg(returning_thread, nullptr), &result);
+	});
+
+	const int yielding = uthread_spawn(yield_peer);
+	measure("yield_round_trip", live_threads, g_samples, []()
+	{
+		uthread_yield();
+	});
+	uthread_terminate(yielding);
+
+	// Running the peer until it blocks itself for the first time
+	const int blocking = uthread_spawn(block_peer);
+	uthread_yield();
+	measure("block_resume_round_trip", live_threads, g_samples, [blocking]()
+	{
+		uthread_resume(blocking);
+		uthread_yield();
+	});
+	uthread_terminate(blocking);
+
+	for (const int quantums : sleep_quantums)
+	{
+		g_sleep_quantums = quantums;
+		g_sleep_late_ns.clear();
+		uthread_spawn(sleep_peer);
+
+		// Waiting without running, so the quantums pass in real time
+		void* item = nullptr;
+		uthread_channel_recv(g_done, &item);
+
+		const std::string benchmark = "sleep_" + std::to_string(quantums) + "q_late";
+		report(benchmark.c_str(), live_threads, g_sleep_late_ns);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		g_samples = std::atol(argv[1]);
+	}
+	if (g_samples <= 0)
+	{
+		std::cerr << "usage: " << argv[0] << " [samples]" << std::endl;
+		return 1;
+	}
+
+	uthread_set_stack_guard(0);
+	uthread_init(quantum_usecs);
+	g_done = uthread_channel_create(0);
+	g_sleep_late_ns.reserve(sleep_samples);
+
+	std::cout << "benchmark,live_threads,samples,mean_ns,p50_ns,p90_ns,p99_ns,max_ns" << std::endl;
+
+	std::vector<int> parked;
+	for (const int live_threads : live_thread_counts)
+	{
+		while (static_cast<int>(parked.size()) < live_threads)
+		{
+			const int tid = uthread_spawn(parked_thread);
+			if (-1 == tid)
+			{
+				std::cerr << "spawning live thread " << parked.size() << " failed" << std::endl;
+				return 1;
+			}
+			uthread_block(tid);
+			parked.push_back(tid);
+		}
+
+		run_benchmarks(live_threads);
+	}
+
+	uthread_terminate(0);
+	return 0;
+}
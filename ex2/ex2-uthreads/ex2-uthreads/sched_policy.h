@@ -0,0 +1,68 @@
+#ifndef SCHED_POLICY_H
+#define SCHED_POLICY_H
+
+#include "thread.h"
+
+/* Enum for the reason a thread is handed to the scheduling policy */
+enum ready_reason : int
+{
+	// The thread has just been spawned
+	READY_SPAWNED,
+	// The thread was blocked or sleeping, and is now ready to run
+	READY_WOKEN,
+	// The quantum of the thread has expired (or a more urgent thread preempted it)
+	READY_PREEMPTED,
+	// The thread has given up the rest of its quantum
+	READY_YIELDED
+};
+
+/*
+ * Interface of a scheduling policy - Keeps the threads which are ready to run,
+ * and decides which runs next and for how long.
+ * The timer ticks every base quantum, and the policy decides on each tick whether the
+ * quantum of the running thread has expired (so a quantum may span several ticks).
+ */
+class sched_policy
+{
+public:
+	virtual ~sched_policy() = default;
+
+	/**
+	 * @brief Queues a thread which is ready to run.
+	 */
+	virtual void enqueue(thread* t, ready_reason reason) = 0;
+
+	/**
+	 * @brief Removes a queued thread (e.g. when it is blocked, terminated, or switched to directly).
+	 */
+	virtual void remove(thread* t) = 0;
+
+	/**
+	 * @brief Removes and returns the next thread to run, or nullptr if no thread is queued.
+	 */
+	virtual thread* dequeue_next() = 0;
+
+	/**
+	 * @brief Returns whether no thread is queued.
+	 */
+	virtual bool empty() const = 0;
+
+	/**
+	 * @brief Called once a thread starts a new quantum (whether it was picked by dequeue_next or not).
+	 */
+	virtual void dispatch(thread* t) = 0;
+
+	/**
+	 * @brief Called once a thread queued by another instance of the policy (of another carrier)
+	 * is moved to this one, before it is dispatched.
+	 */
+	virtual void adopt(thread* /* t */) {}
+
+	/**
+	 * @brief Called on each timer tick while the thread is running.
+	 * @return Whether the running thread should be preempted.
+	 */
+	virtual bool tick(thread* running) = 0;
+};
+
+#endif // SCHED_POLICY_H
@@ -0,0 +1,66 @@
+#include "sleep_wheel.h"
+
+sleep_wheel::sleep_wheel(int next_quantum) :
+	m_next_quantum(next_quantum),
+	m_size(0),
+	m_slots()
+{}
+
+void sleep_wheel::add(thread* t)
+{
+	// A thread whose quantum has already passed, wakes up on the next one
+	const int distance = (t->wake_quantum > m_next_quantum) ? (t->wake_quantum - m_next_quantum) : 0;
+	const int wake_quantum = m_next_quantum + distance;
+
+	// Finding the lowest level which spans the distance
+	int level = 0;
+	while ((level < levels - 1) && (0 != (distance >> (level_bits * (level + 1)))))
+	{
+		level++;
+	}
+
+	m_slots[level][(wake_quantum >> (level_bits * level)) & level_mask].push_back(t);
+	m_size++;
+}
+
+void sleep_wheel::remove(thread* t)
+{
+	t->queue->remove(t);
+	m_size--;
+}
+
+int sleep_wheel::next_wake_quantum() const
+{
+	if (empty())
+	{
+		return -1;
+	}
+
+	// The threads of the lowest level wake up within a slot per quantum, until it wraps around
+	for (int quantum = m_next_quantum; quantum < m_next_quantum + level_slots; quantum++)
+	{
+		if (!m_slots[0][quantum & level_mask].empty())
+		{
+			return quantum;
+		}
+	}
+
+	// The threads of the higher levels move down once the lowest level wraps around
+	return (m_next_quantum + level_mask) & ~level_mask;
+}
+
+int sleep_wheel::cascade(int level)
+{
+	const int index = (m_next_quantum >> (level_bits * level)) & level_mask;
+	thread_queue& slot = m_slots[level][index];
+
+	// The threads are now less than a slot of this level away from waking up,
+	// so each is added to a lower level
+	while (!slot.empty())
+	{
+		m_size--;
+		add(slot.pop_front());
+	}
+
+	return index;
+}
@@ -0,0 +1,100 @@
+#ifndef SLEEP_WHEEL_H
+#define SLEEP_WHEEL_H
+
+#include "thread.h"
+#include "thread_queue.h"
+
+/*
+ * Hierarchical timing wheel of sleeping threads, keyed by the quantum each thread wakes up at
+ * (thread::wake_quantum). Each level has 64 slots, a slot of level N spans 64^N quantums.
+ * Adding and removing a sleeper is O(1), and advancing by a quantum only touches the threads which
+ * wake up on it, plus the threads moved down a level once every 64^N quantums.
+ * Sleeping threads are linked through their queue links, as they are not queued anywhere else.
+ */
+class sleep_wheel
+{
+public:
+	/**
+	 * @brief Creates a wheel whose first quantum to advance to is the given quantum.
+	 */
+	explicit sleep_wheel(int next_quantum);
+
+	sleep_wheel(const sleep_wheel&) = delete;
+	sleep_wheel& operator=(const sleep_wheel&) = delete;
+
+	/**
+	 * @brief Adds the thread to the wheel, to wake up once advanced to its wake_quantum.
+	 */
+	void add(thread* t);
+
+	/**
+	 * @brief Removes the thread from the wheel before it wakes up.
+	 */
+	void remove(thread* t);
+
+	/**
+	 * @brief Advances the wheel up to the given quantum (inclusive), calling 'wake' for each thread whose
+	 * wake_quantum is passed. Advancing to a quantum which was already passed has no effect.
+	 */
+	template <typename Func>
+	void advance_to(int quantum, Func wake);
+
+	bool empty() const { return 0 == m_size; }
+
+	/**
+	 * @brief Returns the quantum the next thread wakes up at, or an earlier quantum at which threads move down
+	 * from a higher level (then it should be called again once advanced to it). Returns -1 if the wheel is empty.
+	 */
+	int next_wake_quantum() const;
+
+private:
+	static constexpr int level_bits = 6;
+	static constexpr int level_slots = 1 << level_bits;
+	static constexpr int level_mask = level_slots - 1;
+	// Enough levels to cover any distance between two int quantums
+	static constexpr int levels = (31 + level_bits - 1) / level_bits;
+
+	// Moves all the threads in the current slot of the level to the lower levels,
+	// returns the index of the slot
+	int cascade(int level);
+
+	// The next quantum to advance to
+	int m_next_quantum;
+	// The number of threads in the wheel
+	int m_size;
+	thread_queue m_slots[levels][level_slots];
+};
+
+template <typename Func>
+void sleep_wheel::advance_to(int quantum, Func wake)
+{
+	// Without threads, there is nothing to move down or wake up on the way
+	if (empty() && (m_next_quantum <= quantum))
+	{
+		m_next_quantum = quantum + 1;
+		return;
+	}
+
+	while (m_next_quantum <= quantum)
+	{
+		// Once the lowest level wraps around, moving the threads of the next slot of each
+		// higher level one level down (as long as the higher level wraps around as well)
+		const int index = m_next_quantum & level_mask;
+		if (0 == index)
+		{
+			for (int level = 1; (level < levels) && (0 == cascade(level)); level++)
+			{}
+		}
+
+		m_next_quantum++;
+
+		thread_queue& slot = m_slots[0][index];
+		while (!slot.empty())
+		{
+			m_size--;
+			wake(slot.pop_front());
+		}
+	}
+}
+
+#endif // SLEEP_WHEEL_H
@@ -0,0 +1,83 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <atomic>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * A lock which busy-waits for a short while, and then waits on a futex until it is released - So a holder which
+ * the kernel has switched out (e.g. as there are more carriers than CPUs) gets to run and release it, rather than
+ * the waiters taking turns spinning.
+ * The lock isn't owned by a specific kernel thread - So it may be released by a different kernel thread than the
+ * one which acquired it (as happens when a user thread is switched out on one carrier and resumed on another).
+ * The lock must not be acquired from a signal handler which may interrupt its holder.
+ */
+class spinlock
+{
+public:
+	spinlock() : m_state(UNLOCKED) {}
+
+	spinlock(const spinlock&) = delete;
+	spinlock& operator=(const spinlock&) = delete;
+
+	void lock()
+	{
+		if (try_lock())
+		{
+			return;
+		}
+
+		// Waiting without hammering the cache line with writes, as the holder is likely to release it soon
+		for (int spins = 0; spins < max_spins; spins++)
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
+			if ((UNLOCKED == m_state.load(std::memory_order_relaxed)) && try_lock())
+			{
+				return;
+			}
+		}
+
+		// Marking the lock as waited on, so it is handed to a waiter once it is released
+		while (UNLOCKED != m_state.exchange(CONTENDED, std::memory_order_acquire))
+		{
+			(void)syscall(SYS_futex, reinterpret_cast<int*>(&m_state), FUTEX_WAIT_PRIVATE, CONTENDED, nullptr, nullptr, 0);
+		}
+	}
+
+	/**
+	 * @brief Takes the lock only if it is free, without waiting.
+	 * @return Whether the lock was taken.
+	 */
+	bool try_lock()
+	{
+		int expected = UNLOCKED;
+		return m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void unlock()
+	{
+		if (CONTENDED == m_state.exchange(UNLOCKED, std::memory_order_release))
+		{
+			(void)syscall(SYS_futex, reinterpret_cast<int*>(&m_state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+		}
+	}
+
+private:
+	static constexpr int max_spins = 128;
+
+	// The state of the lock, the futex word - Contended once a thread waits on the futex (or may be about to)
+	enum : int
+	{
+		UNLOCKED,
+		LOCKED,
+		CONTENDED
+	};
+
+	std::atomic<int> m_state;
+};
+
+#endif // SPINLOCK_H
@@ -0,0 +1,133 @@
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "stack_pool.h"
+
+/*
+ * The timer signal is delivered on the stack of the running thread, and its frame stays there
+ * for as long as the thread is switched out. The frame holds the whole FPU/vector state, which on
+ * recent CPUs is larger than small stacks themselves - So the room for it is added to every stack.
+ */
+static size_t signal_frame_size()
+{
+	long frame_size = MINSIGSTKSZ;
+#ifdef _SC_MINSIGSTKSZ
+	const long min_signal_stack = sysconf(_SC_MINSIGSTKSZ);
+	if (min_signal_stack > frame_size)
+	{
+		frame_size = min_signal_stack;
+	}
+#endif
+	return static_cast<size_t>(frame_size);
+}
+
+stack_pool::stack_pool() :
+	m_page_size(static_cast<size_t>(sysconf(_SC_PAGESIZE))),
+	m_signal_frame_size(signal_frame_size()),
+	m_guarded(true),
+	m_free_stacks(),
+	m_slabs(),
+	m_slab_remainders()
+{}
+
+stack_pool::~stack_pool()
+{
+	if (m_guarded)
+	{
+		for (const auto& entry : m_free_stacks)
+		{
+			for (const thread_stack& stack : entry.second)
+			{
+				(void)munmap(stack.base - m_page_size, stack.size + m_page_size);
+			}
+		}
+	}
+
+	for (const thread_stack& slab : m_slabs)
+	{
+		(void)munmap(slab.base, slab.size);
+	}
+}
+
+thread_stack stack_pool::allocate(size_t size)
+{
+	const size_t stack_size = this->stack_size(size);
+
+	auto free_stacks = m_free_stacks.find(stack_size);
+	if ((m_free_stacks.end() != free_stacks) && !free_stacks->second.empty())
+	{
+		const thread_stack stack = free_stacks->second.back();
+		free_stacks->second.pop_back();
+		return stack;
+	}
+
+	return m_guarded ? allocate_guarded(stack_size) : allocate_from_slab(stack_size);
+}
+
+thread_stack stack_pool::allocate_guarded(size_t stack_size)
+{
+	// The guard page is the lowest, as the stack grows down towards it
+	void* const mapping = mmap(nullptr, stack_size + m_page_size, PROT_READ | PROT_WRITE,
+	                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+	if (MAP_FAILED == mapping)
+	{
+		throw stack_map_error();
+	}
+
+	if (-1 == mprotect(mapping, m_page_size, PROT_NONE))
+	{
+		(void)munmap(mapping, stack_size + m_page_size);
+		throw stack_map_error();
+	}
+
+	return thread_stack{ static_cast<char*>(mapping) + m_page_size, stack_size };
+}
+
+thread_stack stack_pool::allocate_from_slab(size_t stack_size)
+{
+	thread_stack& remainder = m_slab_remainders[stack_size];
+	if (remainder.size < stack_size)
+	{
+		const size_t slab_size = stack_size * stacks_per_slab;
+		void* const mapping = mmap(nullptr, slab_size, PROT_READ | PROT_WRITE,
+		                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+		if (MAP_FAILED == mapping)
+		{
+			throw stack_map_error();
+		}
+
+		m_slabs.push_back(thread_stack{ static_cast<char*>(mapping), slab_size });
+		remainder = m_slabs.back();
+	}
+
+	const thread_stack stack{ remainder.base, stack_size };
+	remainder.base += stack_size;
+	remainder.size -= stack_size;
+	return stack;
+}
+
+size_t stack_pool::stack_size(size_t size) const
+{
+	// Rounding up to whole pages, so stacks of close sizes are reused for one another
+	return (size + m_signal_frame_size + m_page_size - 1) & ~(m_page_size - 1);
+}
+
+void stack_pool::release(const thread_stack& stack)
+{
+	std::vector<thread_stack>& free_stacks = m_free_stacks[stack.size];
+	if (free_stacks.size() >= max_cached_stacks)
+	{
+		if (m_guarded)
+		{
+			(void)munmap(stack.base - m_page_size, stack.size + m_page_size);
+			return;
+		}
+
+		// Unmapping a part of a shared mapping would split it, taking another mapping - So only its pages are freed
+		(void)madvise(stack.base, stack.size, MADV_DONTNEED);
+	}
+
+	free_stacks.push_back(stack);
+}
@@ -0,0 +1,79 @@
+#ifndef STACK_POOL_H
+#define STACK_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+/* A stack of a user thread, 'base' is its lowest usable address */
+struct thread_stack
+{
+	char* base;
+	size_t size;
+};
+
+/* Thrown by stack_pool::allocate when a stack cannot be mapped, rather than when the heap is exhausted */
+class stack_map_error : public std::bad_alloc
+{};
+
+/*
+ * Allocates the stacks of the user threads. By default each stack is mapped on its own with a guard page below it,
+ * so overflowing it faults rather than corrupting other memory - Which takes two of the process' memory mappings
+ * (limited by vm.max_map_count, 65530 by default) per stack. Without guard pages, the stacks are carved from
+ * mappings shared by many of them, so hundreds of thousands of stacks fit. The pages of a stack are committed by
+ * the kernel only once touched, so large stacks cost only as much as they use.
+ * Released stacks are kept by their size and reused by later allocations, without any system call.
+ */
+class stack_pool
+{
+public:
+	stack_pool();
+	~stack_pool();
+
+	stack_pool(const stack_pool&) = delete;
+	stack_pool& operator=(const stack_pool&) = delete;
+
+	/**
+	 * @brief Selects whether stacks have guard pages, before any stack is allocated.
+	 */
+	void set_guarded(bool guarded) { m_guarded = guarded; }
+
+	/**
+	 * @brief Allocates a stack with at least 'size' usable bytes, on top of the room required for a signal frame.
+	 * Throws stack_map_error if the stack cannot be mapped, and std::bad_alloc if the heap is exhausted.
+	 */
+	thread_stack allocate(size_t size);
+
+	/**
+	 * @brief Returns the size of the stacks allocated for 'size', the stacks of the same size are reused for one another.
+	 */
+	size_t stack_size(size_t size) const;
+
+	/**
+	 * @brief Returns the stack to the pool, it must not be in use anymore.
+	 */
+	void release(const thread_stack& stack);
+
+private:
+	// The number of released stacks kept for each size, any more are unmapped - Or, for stacks without guard pages
+	// (which share their mapping), kept with their pages returned to the kernel
+	static constexpr size_t max_cached_stacks = 1024;
+	// The number of stacks without guard pages carved from each mapping
+	static constexpr size_t stacks_per_slab = 64;
+
+	thread_stack allocate_guarded(size_t stack_size);
+	thread_stack allocate_from_slab(size_t stack_size);
+
+	const size_t m_page_size;
+	// The room for a signal frame added to every stack
+	const size_t m_signal_frame_size;
+	bool m_guarded;
+	// Released stacks, by their size
+	std::unordered_map<size_t, std::vector<thread_stack>> m_free_stacks;
+	// The mappings stacks without guard pages are carved from, and the room left in the last one of each stack size
+	std::vector<thread_stack> m_slabs;
+	std::unordered_map<size_t, thread_stack> m_slab_remainders;
+};
+
+#endif // STACK_POOL_H
@@ -0,0 +1,67 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "spinlock.h"
+#include "thread.h"
+#include "thread_queue.h"
+#include "uthreads.h"
+
+/*
+ * The synchronization primitives of the library. The threads waiting on them are BLOCKED and queued in
+ * their wait queues (with thread::is_waiting set), so waiting never spins - A waiting thread is handed
+ * what it waits for directly (the mutex, or the channel's item) and made READY, in FIFO order.
+ * Each of them has a lock of its own guarding its state (and its waiting threads), so operating on different
+ * primitives doesn't serialize the carriers on the library's lock - See object_lock.
+ */
+
+struct uthread_mutex
+{
+	// Set in 'state' while threads wait on the mutex (threads are aligned, so the bit is never part of their address)
+	static constexpr uintptr_t HAS_WAITERS = 1;
+
+	uthread_mutex() : lock(), state(0), waiters() {}
+
+	/* The thread holding the mutex, or nullptr if it is unlocked */
+	thread* owner() const
+	{
+		return reinterpret_cast<thread*>(state.load(std::memory_order_relaxed) & ~HAS_WAITERS);
+	}
+
+	spinlock lock;
+	// The thread holding the mutex (0 if it is unlocked), along with HAS_WAITERS - An uncontended mutex
+	// is locked and unlocked by a compare-and-swap of it alone, and its lock is taken only once threads wait on it
+	std::atomic<uintptr_t> state;
+	thread_queue waiters;
+};
+
+struct uthread_cond
+{
+	uthread_cond() : lock(), mutex(nullptr), waiters() {}
+
+	// Taken before the lock of the mutex, when both are required
+	spinlock lock;
+	// The mutex the waiters have released, and reacquire once they are signaled
+	uthread_mutex* mutex;
+	thread_queue waiters;
+};
+
+struct uthread_channel
+{
+	explicit uthread_channel(int capacity) : lock(), items(capacity), head(0), count(0), senders(), receivers() {}
+
+	spinlock lock;
+	// The buffered items, as a cyclic buffer starting at 'head'
+	std::vector<void*> items;
+	size_t head;
+	size_t count;
+	// Threads waiting for room in the buffer (with their items in thread::wait_item),
+	// and threads waiting for an item - Never both at the same time
+	thread_queue senders;
+	thread_queue receivers;
+};
+
+#endif // SYNC_H
@@ -0,0 +1,148 @@
+/*
+ * Benchmark for the synchronization primitives of the library.
+ * Measures the cost of locking and unlocking an uncontended mutex, of a mutex contended by
+ * threads which hold it across a switch (so every lock waits and is handed the mutex),
+ * and of passing items between two threads over a condition variable and over a channel.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "uthreads.h"
+
+constexpr int quantum_usecs = 100000;
+constexpr int contending_threads = 4;
+constexpr long default_iterations = 100000;
+
+static long g_iterations = default_iterations;
+
+static uthread_mutex* g_mutex = nullptr;
+static uthread_cond* g_cond = nullptr;
+static uthread_channel* g_channel = nullptr;
+static long g_done = 0;
+static long g_turn = 0;
+
+static void contending_thread()
+{
+	for (long i = 0; i < g_iterations; i++)
+	{
+		uthread_mutex_lock(g_mutex);
+		// Holding the mutex across a switch, so the other threads wait on it
+		uthread_yield();
+		uthread_mutex_unlock(g_mutex);
+	}
+
+	g_done++;
+	uthread_terminate(uthread_get_tid());
+}
+
+static void cond_peer()
+{
+	uthread_mutex_lock(g_mutex);
+	for (long i = 0; i < g_iterations; i++)
+	{
+		while (0 == g_turn)
+		{
+			uthread_cond_wait(g_cond, g_mutex);
+		}
+		g_turn = 0;
+		uthread_cond_signal(g_cond);
+	}
+	uthread_mutex_unlock(g_mutex);
+
+	uthread_terminate(uthread_get_tid());
+}
+
+static void channel_peer()
+{
+	void* item = nullptr;
+	for (long i = 0; i < g_iterations; i++)
+	{
+		uthread_channel_recv(g_channel, &item);
+	}
+
+	uthread_terminate(uthread_get_tid());
+}
+
+template <typename Func>
+static double measure_ns(long operations, Func func)
+{
+	const auto start = std::chrono::steady_clock::now();
+	func();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		g_iterations = std::atol(argv[1]);
+	}
+	if (g_iterations <= 0)
+	{
+		std::cerr << "usage: " << argv[0] << " [iterations]" << std::endl;
+		return 1;
+	}
+
+	uthread_init(quantum_usecs);
+	g_mutex = uthread_mutex_create();
+	g_cond = uthread_cond_create();
+	g_channel = uthread_channel_create(0);
+
+	const double uncontended_ns = measure_ns(g_iterations, []()
+	{
+		for (long i = 0; i < g_iterations; i++)
+		{
+			uthread_mutex_lock(g_mutex);
+			uthread_mutex_unlock(g_mutex);
+		}
+	});
+
+	const double contended_ns = measure_ns(g_iterations * contending_threads, []()
+	{
+		for (int i = 0; i < contending_threads; i++)
+		{
+			uthread_spawn(contending_thread);
+		}
+		while (contending_threads != g_done)
+		{
+			uthread_yield();
+		}
+	});
+
+	const double cond_ns = measure_ns(g_iterations, []()
+	{
+		uthread_spawn(cond_peer);
+		uthread_mutex_lock(g_mutex);
+		for (long i = 0; i < g_iterations; i++)
+		{
+			g_turn = 1;
+			uthread_cond_signal(g_cond);
+			while (1 == g_turn)
+			{
+				uthread_cond_wait(g_cond, g_mutex);
+			}
+		}
+		uthread_mutex_unlock(g_mutex);
+	});
+
+	const double channel_ns = measure_ns(g_iterations, []()
+	{
+		uthread_spawn(channel_peer);
+		for (long i = 0; i < g_iterations; i++)
+		{
+			uthread_channel_send(g_channel, nullptr);
+		}
+	});
+
+	std::cout << "uncontended mutex lock+unlock: " << uncontended_ns << " ns" << std::endl;
+	std::cout << "contended mutex lock+unlock (" << contending_threads << " threads): " << contended_ns << " ns"
+	          << std::endl;
+	std::cout << "condition variable round trip: " << cond_ns << " ns" << std::endl;
+	std::cout << "unbuffered channel send: " << channel_ns << " ns" << std::endl;
+
+	uthread_terminate(0);
+	return 0;
+}
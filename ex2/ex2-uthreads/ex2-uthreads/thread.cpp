@@ -1,82 +1,68 @@
-#include <signal.h>
-
 #include "thread.h"
+#include "trace.h"
 
-#ifdef __x86_64__
-/* code for 64 bit Intel arch */
-
-typedef unsigned long address_t;
-#define JB_SP 6
-#define JB_PC 7
-
-/* A translation is required when using an address of a variable.
-   Use this as a black box in your code. */
-address_t translate_address(address_t addr)
-{
-    address_t ret;
-    asm volatile("xor    %%fs:0x30,%0\n"
-        "rol    $0x11,%0\n"
-        : "=g" (ret)
-        : "0" (addr));
-    return ret;
-}
-
-#else
-/* code for 32 bit Intel arch */
-
-typedef unsigned int address_t;
-#define JB_SP 4
-#define JB_PC 5
-
-/* A translation is required when using an address of a variable.
-   Use this as a black box in your code. */
-address_t translate_address(address_t addr)
-{
-    address_t ret;
-    asm volatile("xor    %%gs:0x18,%0\n"
-        "rol    $0x9,%0\n"
-        : "=g" (ret)
-        : "0" (addr));
-    return ret;
-}
-
-#endif
-
-thread::thread(thread_id id, thread_entry_point ep) :
+thread::thread(thread_id id, thread_entry_point ep, thread_entry_point_arg ep_arg, void* arg,
+               context_entry_point start, int priority, const thread_stack& stack) :
     id(id),
-    env_blk(),
+    entry_point(ep),
+    entry_point_arg(ep_arg),
+    arg(arg),
+    ctx(),
     state(READY),
-    sleep_time(0),
+    wake_quantum(0),
 	is_blocked(false),
+	is_waiting(false),
+	wait_lock(nullptr),
+	wait_item(nullptr),
+	io_fd(-1),
+	io_events(0),
+	wake_time(0),
 	elapsed_quantums(0),
-    stack(new char[STACK_SIZE])
+	run_start_tsc(0),
+	run_cycles(0),
+    priority(priority),
+    sched_level(priority),
+    sched_ticks(0),
+    sched_epoch(0),
+    sched_weight(DEFAULT_WEIGHT),
+    sched_vruntime(0),
+    sched_charged_cycles(0),
+    rt_period_ns(0),
+    rt_deadline(0),
+    rt_budget_cycles(0),
+    rt_job_start_cycles(0),
+    rt_utilization(0),
+    rt_throttled(false),
+    rt_misses(0),
+    carrier_index(0),
+    terminate_pending(false),
+    joinable(nullptr != ep_arg),
+    result(nullptr),
+    joiners(),
+    queue(nullptr),
+    queue_prev(nullptr),
+    queue_next(nullptr),
+    tree_parent(nullptr),
+    tree_left(nullptr),
+    tree_right(nullptr),
+    tree_red(false),
+    stack(stack)
 {
-    // Initializes environment block to use the right stack,
-    // and to run from the function 'entry_point',
-    // when we'll use siglongjmp to jump into the thread.
-    // * This code has been adapted from the code provided in the exercise *
-    address_t sp = reinterpret_cast<address_t>(stack + STACK_SIZE - sizeof(address_t));
-    address_t pc = reinterpret_cast<address_t>(ep);
-    // return value omitted, as this is only initialization
-    (void)sigsetjmp(env_blk, 1);
-    (env_blk->__jmpbuf)[JB_SP] = translate_address(sp);
-    (env_blk->__jmpbuf)[JB_PC] = translate_address(pc);
-    (void)sigemptyset(&env_blk->__saved_mask);
+    // Initializes the context to use the right stack, and to run from 'start'
+    // once we'll switch into the thread.
+    context_init(&ctx, stack.base, stack.size, start, this);
 }
 
 thread::thread(thread_id id) :
-    id(id), env_blk(), state(RUNNING), sleep_time(0), is_blocked(false), elapsed_quantums(1), stack(nullptr)
+    id(id), entry_point(nullptr), entry_point_arg(nullptr), arg(nullptr), ctx(), state(RUNNING), wake_quantum(0),
+    is_blocked(false), is_waiting(false), wait_lock(nullptr),
+    wait_item(nullptr), io_fd(-1), io_events(0), wake_time(0), elapsed_quantums(1), run_start_tsc(read_tsc()),
+    run_cycles(0), priority(0), sched_level(0),
+    sched_ticks(0), sched_epoch(0), sched_weight(DEFAULT_WEIGHT), sched_vruntime(0), sched_charged_cycles(0),
+    rt_period_ns(0), rt_deadline(0), rt_budget_cycles(0), rt_job_start_cycles(0), rt_utilization(0), rt_throttled(false),
+    rt_misses(0), carrier_index(0), terminate_pending(false),
+    joinable(false), result(nullptr), joiners(), queue(nullptr), queue_prev(nullptr), queue_next(nullptr),
+    tree_parent(nullptr), tree_left(nullptr), tree_right(nullptr), tree_red(false), stack{ nullptr, 0 }
 {
-    // return value omitted, as this is only initialization
-    (void)sigsetjmp(env_blk, 1);
-}
-
-thread::~thread()
-{
-    if (nullptr == stack)
-    {
-	    return;
-	}
-
-    delete[] stack;
+    // The context is saved on the first switch out of the thread
 }
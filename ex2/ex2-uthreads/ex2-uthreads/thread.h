@@ -1,8 +1,14 @@
 #ifndef THREAD_H
 #define THREAD_H
 
-#include <setjmp.h>
+#include <atomic>
+#include <cstdint>
 
+#include "context.h"
+#include "spinlock.h"
+#include "stack_pool.h"
+#include "thread_queue.h"
+#include "thread_tree.h"
 #include "uthreads.h"
 
 using thread_id = int;
@@ -11,30 +17,104 @@ enum thread_state : int
 {
 	READY,
 	RUNNING,
-	BLOCKED
+	BLOCKED,
+	// Terminated, but kept (with its result) until it is joined
+	ZOMBIE
 };
 
 /* Represents a thread in the User-Threads Library */
 class thread
 {
 public:
-	// Constructor for regular user thread
-	thread(thread_id id, thread_entry_point ep);
+	// Constructor for regular user thread running on 'stack', the context starts from 'start',
+	// which receives the thread itself and is expected to call the entry point - Either 'ep', or 'ep_arg'
+	// with 'arg' (then the thread is joinable)
+	thread(thread_id id, thread_entry_point ep, thread_entry_point_arg ep_arg, void* arg, context_entry_point start,
+		   int priority, const thread_stack& stack);
 	// Constructor for thread forked from the current thread,
 	// unlike starting from a whole new EP (primarily for the main thread)
 	thread(thread_id id);
-	~thread();
 
 	const thread_id id;
-	// The environment block of the thread
-	sigjmp_buf env_blk;
+	const thread_entry_point entry_point;
+	const thread_entry_point_arg entry_point_arg;
+	void* const arg;
+	// The saved execution context of the thread
+	context ctx;
 	thread_state state;
-	int sleep_time;
+	// The quantum the thread wakes up at, or 0 if it isn't sleeping
+	int wake_quantum;
 	bool is_blocked;
+	// Set while the thread waits on a mutex, condition variable or channel (or joins a thread), queued in its
+	// wait queue
+	bool is_waiting;
+	// The lock guarding what the thread waits on, if it isn't the manager's lock (the lock of a synchronization
+	// primitive, or of the I/O poller) - Cleared once the thread is woken up, see thread_carrier_lock
+	std::atomic<spinlock*> wait_lock;
+	// The item a thread waiting to send on a channel sends, or the item handed to a thread waiting to receive
+	// (or the result handed to a joining thread)
+	void* wait_item;
+	// The file descriptor the thread waits on (or -1), and the events it waits for - Or once woken up, the
+	// events which are ready, see io_poller
+	int io_fd;
+	unsigned int io_events;
+	// The time of the monotonic clock (in nanoseconds) the thread wakes up at, if it sleeps in real time (or 0)
+	long long wake_time;
 	int elapsed_quantums;
+	// The timestamp counter (see read_tsc) the thread has last started running at, and the cycles it has run for
+	// until then
+	uint64_t run_start_tsc;
+	uint64_t run_cycles;
 
-private:
-	char* stack;
+	// The priority hint given on spawn (0 being the highest)
+	const int priority;
+	// State kept by the scheduling policy
+	int sched_level;
+	int sched_ticks;
+	unsigned int sched_epoch;
+	// The weight of the thread (see uthread_set_weight), its virtual runtime and the cycles of its run time
+	// already added to the virtual runtime - Kept by the fair-share policy
+	int sched_weight;
+	uint64_t sched_vruntime;
+	uint64_t sched_charged_cycles;
+	// The real-time parameters of the thread (see uthread_set_periodic), a period of 0 for a normal thread -
+	// The deadline of its current job (the end of its period, by the monotonic clock in nanoseconds), its budget
+	// in cycles, the run cycles the job has started at, and the utilization it was admitted with (in millionths)
+	long long rt_period_ns;
+	uint64_t rt_deadline;
+	uint64_t rt_budget_cycles;
+	uint64_t rt_job_start_cycles;
+	long long rt_utilization;
+	// Set once the job has run for its whole budget, until its next period - It runs as a normal thread meanwhile
+	bool rt_throttled;
+	int rt_misses;
+
+	// The index of the carrier the thread is running on, or is queued to run on - Read without the carrier's lock
+	// to find the carrier to lock, see thread_carrier_lock
+	std::atomic<int> carrier_index;
+	// Set when the thread is terminated while running on another carrier,
+	// so it is terminated once it is switched out
+	bool terminate_pending;
+	// Whether the thread is kept as a ZOMBIE once it terminates, until it is joined - With the value its
+	// entry point has returned (or nullptr), handed to the threads joining it
+	const bool joinable;
+	void* result;
+	// The threads waiting for the thread to terminate, see uthread_join
+	thread_queue joiners;
+
+	// Links of the thread in the queue it waits in (if any), see thread_queue
+	// (sleeping threads are linked in the sleep wheel's queues)
+	thread_queue* queue;
+	thread* queue_prev;
+	thread* queue_next;
+	// Links of the thread in the tree it is ordered in (if any), see thread_tree
+	thread* tree_parent;
+	thread* tree_left;
+	thread* tree_right;
+	bool tree_red;
+
+	// The stack of the thread, owned by the stack pool (no stack for the main thread)
+	const thread_stack stack;
 };
 
 #endif // THREAD_H
\ No newline at end of file
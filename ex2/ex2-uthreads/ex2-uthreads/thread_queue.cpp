@@ -0,0 +1,113 @@
+#include "thread.h"
+#include "thread_queue.h"
+
+thread_queue::thread_queue() :
+	m_head(nullptr),
+	m_tail(nullptr),
+	m_size(0)
+{}
+
+void thread_queue::push_back(thread* t)
+{
+	t->queue = this;
+	t->queue_prev = m_tail;
+	t->queue_next = nullptr;
+
+	if (nullptr == m_tail)
+	{
+		m_head = t;
+	}
+	else
+	{
+		m_tail->queue_next = t;
+	}
+	m_tail = t;
+	m_size++;
+}
+
+void thread_queue::push_front(thread* t)
+{
+	t->queue = this;
+	t->queue_prev = nullptr;
+	t->queue_next = m_head;
+
+	if (nullptr == m_head)
+	{
+		m_tail = t;
+	}
+	else
+	{
+		m_head->queue_prev = t;
+	}
+	m_head = t;
+	m_size++;
+}
+
+thread* thread_queue::pop_front()
+{
+	thread* const t = m_head;
+	unlink(t);
+	return t;
+}
+
+bool thread_queue::remove(thread* t)
+{
+	if (this != t->queue)
+	{
+		return false;
+	}
+
+	unlink(t);
+	return true;
+}
+
+void thread_queue::unlink(thread* t)
+{
+	// Unlinking the thread from its neighbours (or from the queue's ends)
+	if (nullptr == t->queue_prev)
+	{
+		m_head = t->queue_next;
+	}
+	else
+	{
+		t->queue_prev->queue_next = t->queue_next;
+	}
+
+	if (nullptr == t->queue_next)
+	{
+		m_tail = t->queue_prev;
+	}
+	else
+	{
+		t->queue_next->queue_prev = t->queue_prev;
+	}
+
+	t->queue = nullptr;
+	t->queue_prev = nullptr;
+	t->queue_next = nullptr;
+	m_size--;
+}
+
+void thread_queue::splice_back(thread_queue& other)
+{
+	if ((this == &other) || other.empty())
+	{
+		return;
+	}
+
+	if (nullptr == m_tail)
+	{
+		m_head = other.m_head;
+	}
+	else
+	{
+		m_tail->queue_next = other.m_head;
+		other.m_head->queue_prev = m_tail;
+	}
+	m_tail = other.m_tail;
+	m_size += other.m_size;
+
+	other.m_head = nullptr;
+	other.m_tail = nullptr;
+	other.m_size = 0;
+}
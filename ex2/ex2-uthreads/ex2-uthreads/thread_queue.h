@@ -0,0 +1,58 @@
+#ifndef THREAD_QUEUE_H
+#define THREAD_QUEUE_H
+
+#include <cstddef>
+
+class thread;
+
+/*
+ * A FIFO queue of threads, linked through the threads themselves (see thread::queue_prev/next),
+ * so queueing never allocates and all the operations are O(1).
+ * A thread may be queued in a single queue at a time.
+ */
+class thread_queue
+{
+public:
+	thread_queue();
+
+	thread_queue(const thread_queue&) = delete;
+	thread_queue& operator=(const thread_queue&) = delete;
+
+	bool empty() const { return nullptr == m_head; }
+	size_t size() const { return m_size; }
+	thread* front() const { return m_head; }
+
+	void push_back(thread* t);
+	void push_front(thread* t);
+
+	/**
+	 * @brief Removes and returns the first thread in the queue, the queue must not be empty.
+	 */
+	thread* pop_front();
+
+	/**
+	 * @brief Removes the thread from the queue, if it is queued in it.
+	 * @return Whether the thread was queued in this queue.
+	 */
+	bool remove(thread* t);
+
+	/**
+	 * @brief Removes a thread which is known to be queued in this queue, even if it was moved here by
+	 * splice_back (then its queue field still points at the queue it was moved from).
+	 */
+	void unlink(thread* t);
+
+	/**
+	 * @brief Moves all the threads of the other queue to the end of this one in O(1), leaving the other empty.
+	 * The moved threads aren't visited, so their queue field keeps pointing at the other queue - The caller
+	 * must keep track of where they are, and take them out with unlink (or pop_front) rather than remove.
+	 */
+	void splice_back(thread_queue& other);
+
+private:
+	thread* m_head;
+	thread* m_tail;
+	size_t m_size;
+};
+
+#endif // THREAD_QUEUE_H
@@ -0,0 +1,50 @@
+#include "thread_table.h"
+
+thread_table::thread_table() :
+	m_chunks(),
+	m_next_id(0),
+	m_free_ids()
+{}
+
+thread*& thread_table::slot(thread_id tid) const
+{
+	return m_chunks[tid / chunk_size][tid % chunk_size];
+}
+
+thread* thread_table::get(thread_id tid) const
+{
+	if ((tid < 0) || (tid >= m_next_id))
+	{
+		return nullptr;
+	}
+
+	return slot(tid);
+}
+
+void thread_table::erase(thread_id tid)
+{
+	slot(tid) = nullptr;
+	m_free_ids.push_back(tid);
+}
+
+thread_id thread_table::allocate_id()
+{
+	if (!m_free_ids.empty())
+	{
+		const thread_id tid = m_free_ids.back();
+		m_free_ids.pop_back();
+		return tid;
+	}
+
+	// Making room for the new ID, if it starts a new chunk
+	if (m_next_id == static_cast<thread_id>(m_chunks.size()) * chunk_size)
+	{
+		// Reserving the free IDs stack to the table's capacity beforehand,
+		// so releasing an ID never allocates
+		m_free_ids.reserve(m_chunks.size() * chunk_size + chunk_size);
+		chunk new_chunk(new thread*[chunk_size]());
+		m_chunks.push_back(std::move(new_chunk));
+	}
+
+	return m_next_id++;
+}
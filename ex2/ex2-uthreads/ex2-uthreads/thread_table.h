@@ -0,0 +1,91 @@
+#ifndef THREAD_TABLE_H
+#define THREAD_TABLE_H
+
+#include <memory>
+#include <vector>
+
+#include "thread.h"
+
+/*
+ * Maps thread IDs to their threads. The table grows in fixed size chunks,
+ * so it is unlimited in size and growing it never moves the existing entries.
+ * IDs are allocated and released in O(1) - Released IDs are reused before new ones.
+ */
+class thread_table
+{
+public:
+	thread_table();
+
+	thread_table(const thread_table&) = delete;
+	thread_table& operator=(const thread_table&) = delete;
+
+	/**
+	 * @brief Returns the thread mapped to the ID, or nullptr if there is no such thread.
+	 */
+	thread* get(thread_id tid) const;
+
+	/**
+	 * @brief Allocates an ID and maps the thread to it, the ID is passed to 'create' which is expected
+	 * to return the new thread. May throw std::bad_alloc, in which case the table is left unchanged.
+	 */
+	template <typename Factory>
+	thread* insert(Factory create);
+
+	/**
+	 * @brief Unmaps the thread with the ID (without deleting it), the ID may be reused afterwards.
+	 */
+	void erase(thread_id tid);
+
+	/**
+	 * @brief Calls 'func' on all the threads in the table.
+	 */
+	template <typename Func>
+	void for_each(Func func) const;
+
+private:
+	static constexpr thread_id chunk_size = 1024;
+	using chunk = std::unique_ptr<thread*[]>;
+
+	thread*& slot(thread_id tid) const;
+	thread_id allocate_id();
+
+	std::vector<chunk> m_chunks;
+	// The lowest ID which was never allocated
+	thread_id m_next_id;
+	// Released IDs, as a stack
+	std::vector<thread_id> m_free_ids;
+};
+
+template <typename Factory>
+thread* thread_table::insert(Factory create)
+{
+	const thread_id tid = allocate_id();
+	thread* new_thread = nullptr;
+	try
+	{
+		new_thread = create(tid);
+	}
+	catch (...)
+	{
+		m_free_ids.push_back(tid);
+		throw;
+	}
+
+	slot(tid) = new_thread;
+	return new_thread;
+}
+
+template <typename Func>
+void thread_table::for_each(Func func) const
+{
+	for (thread_id tid = 0; tid < m_next_id; tid++)
+	{
+		thread* const t = slot(tid);
+		if (nullptr != t)
+		{
+			func(t);
+		}
+	}
+}
+
+#endif // THREAD_TABLE_H
@@ -0,0 +1,336 @@
+#include "thread.h"
+#include "thread_tree.h"
+
+/* Returns the thread following the given one in the tree, or nullptr if it is the last */
+static thread* next_thread(thread* t)
+{
+	if (nullptr != t->tree_right)
+	{
+		t = t->tree_right;
+		while (nullptr != t->tree_left)
+		{
+			t = t->tree_left;
+		}
+		return t;
+	}
+
+	while ((nullptr != t->tree_parent) && (t == t->tree_parent->tree_right))
+	{
+		t = t->tree_parent;
+	}
+	return t->tree_parent;
+}
+
+/* Returns whether the node is red, leaves (nullptr) are black */
+static bool is_red(const thread* t)
+{
+	return (nullptr != t) && t->tree_red;
+}
+
+thread_tree::thread_tree(uint64_t thread::* key) :
+	m_key(key),
+	m_root(nullptr),
+	m_first(nullptr),
+	m_size(0)
+{}
+
+thread* thread_tree::next(thread* t) const
+{
+	return next_thread(t);
+}
+
+void thread_tree::insert(thread* t)
+{
+	// Descending to the leaf the thread is linked at, to the right of threads with the same key
+	thread* parent = nullptr;
+	thread** link = &m_root;
+	bool first = true;
+	while (nullptr != *link)
+	{
+		parent = *link;
+		if (t->*m_key < parent->*m_key)
+		{
+			link = &parent->tree_left;
+		}
+		else
+		{
+			link = &parent->tree_right;
+			first = false;
+		}
+	}
+
+	t->tree_parent = parent;
+	t->tree_left = nullptr;
+	t->tree_right = nullptr;
+	t->tree_red = true;
+	*link = t;
+	if (first)
+	{
+		m_first = t;
+	}
+	m_size++;
+
+	insert_fixup(t);
+}
+
+thread* thread_tree::pop_front()
+{
+	thread* const t = m_first;
+	remove(t);
+	return t;
+}
+
+bool thread_tree::remove(thread* t)
+{
+	// Only the root has no parent, and the links of threads out of any tree are cleared
+	if ((nullptr == t->tree_parent) && (m_root != t))
+	{
+		return false;
+	}
+
+	if (m_first == t)
+	{
+		m_first = next_thread(t);
+	}
+
+	// The node taken out of its place is the thread itself if it has at most a single child,
+	// otherwise it is the thread following it (which has no left child), moved to the thread's place
+	thread* child = nullptr;
+	thread* child_parent = nullptr;
+	bool removed_red = false;
+	if ((nullptr == t->tree_left) || (nullptr == t->tree_right))
+	{
+		child = (nullptr != t->tree_left) ? t->tree_left : t->tree_right;
+		child_parent = t->tree_parent;
+		removed_red = t->tree_red;
+		if (nullptr != child)
+		{
+			child->tree_parent = t->tree_parent;
+		}
+		replace_child(t->tree_parent, t, child);
+	}
+	else
+	{
+		thread* successor = t->tree_right;
+		while (nullptr != successor->tree_left)
+		{
+			successor = successor->tree_left;
+		}
+
+		removed_red = successor->tree_red;
+		child = successor->tree_right;
+		if (successor->tree_parent == t)
+		{
+			child_parent = successor;
+		}
+		else
+		{
+			child_parent = successor->tree_parent;
+			if (nullptr != child)
+			{
+				child->tree_parent = successor->tree_parent;
+			}
+			successor->tree_parent->tree_left = child;
+			successor->tree_right = t->tree_right;
+			t->tree_right->tree_parent = successor;
+		}
+
+		successor->tree_left = t->tree_left;
+		t->tree_left->tree_parent = successor;
+		replace_child(t->tree_parent, t, successor);
+		successor->tree_parent = t->tree_parent;
+		successor->tree_red = t->tree_red;
+	}
+
+	if (!removed_red)
+	{
+		remove_fixup(child, child_parent);
+	}
+
+	t->tree_parent = nullptr;
+	t->tree_left = nullptr;
+	t->tree_right = nullptr;
+	m_size--;
+	return true;
+}
+
+void thread_tree::replace_child(thread* parent, thread* old, thread* child)
+{
+	if (nullptr == parent)
+	{
+		m_root = child;
+	}
+	else if (parent->tree_left == old)
+	{
+		parent->tree_left = child;
+	}
+	else
+	{
+		parent->tree_right = child;
+	}
+}
+
+void thread_tree::rotate_left(thread* t)
+{
+	thread* const right = t->tree_right;
+	t->tree_right = right->tree_left;
+	if (nullptr != right->tree_left)
+	{
+		right->tree_left->tree_parent = t;
+	}
+
+	right->tree_parent = t->tree_parent;
+	replace_child(t->tree_parent, t, right);
+	right->tree_left = t;
+	t->tree_parent = right;
+}
+
+void thread_tree::rotate_right(thread* t)
+{
+	thread* const left = t->tree_left;
+	t->tree_left = left->tree_right;
+	if (nullptr != left->tree_right)
+	{
+		left->tree_right->tree_parent = t;
+	}
+
+	left->tree_parent = t->tree_parent;
+	replace_child(t->tree_parent, t, left);
+	left->tree_right = t;
+	t->tree_parent = left;
+}
+
+void thread_tree::insert_fixup(thread* t)
+{
+	// A red node with a red parent is pushed up the tree, by recoloring or by rotations
+	while (is_red(t->tree_parent))
+	{
+		thread* parent = t->tree_parent;
+		// The parent is red, so it isn't the root
+		thread* const grandparent = parent->tree_parent;
+		if (parent == grandparent->tree_left)
+		{
+			thread* const uncle = grandparent->tree_right;
+			if (is_red(uncle))
+			{
+				parent->tree_red = false;
+				uncle->tree_red = false;
+				grandparent->tree_red = true;
+				t = grandparent;
+				continue;
+			}
+
+			if (t == parent->tree_right)
+			{
+				rotate_left(parent);
+				t = parent;
+				parent = t->tree_parent;
+			}
+			parent->tree_red = false;
+			grandparent->tree_red = true;
+			rotate_right(grandparent);
+		}
+		else
+		{
+			thread* const uncle = grandparent->tree_left;
+			if (is_red(uncle))
+			{
+				parent->tree_red = false;
+				uncle->tree_red = false;
+				grandparent->tree_red = true;
+				t = grandparent;
+				continue;
+			}
+
+			if (t == parent->tree_left)
+			{
+				rotate_right(parent);
+				t = parent;
+				parent = t->tree_parent;
+			}
+			parent->tree_red = false;
+			grandparent->tree_red = true;
+			rotate_left(grandparent);
+		}
+	}
+
+	m_root->tree_red = false;
+}
+
+void thread_tree::remove_fixup(thread* t, thread* parent)
+{
+	// The place of 't' lacks a black node, which is taken from its sibling's side or pushed up the tree
+	while ((m_root != t) && !is_red(t))
+	{
+		if (t == parent->tree_left)
+		{
+			// The sibling exists, as the other side has a black node more
+			thread* sibling = parent->tree_right;
+			if (sibling->tree_red)
+			{
+				sibling->tree_red = false;
+				parent->tree_red = true;
+				rotate_left(parent);
+				sibling = parent->tree_right;
+			}
+
+			if (!is_red(sibling->tree_left) && !is_red(sibling->tree_right))
+			{
+				sibling->tree_red = true;
+				t = parent;
+				parent = t->tree_parent;
+				continue;
+			}
+
+			if (!is_red(sibling->tree_right))
+			{
+				sibling->tree_left->tree_red = false;
+				sibling->tree_red = true;
+				rotate_right(sibling);
+				sibling = parent->tree_right;
+			}
+			sibling->tree_red = parent->tree_red;
+			parent->tree_red = false;
+			sibling->tree_right->tree_red = false;
+			rotate_left(parent);
+			t = m_root;
+		}
+		else
+		{
+			thread* sibling = parent->tree_left;
+			if (sibling->tree_red)
+			{
+				sibling->tree_red = false;
+				parent->tree_red = true;
+				rotate_right(parent);
+				sibling = parent->tree_left;
+			}
+
+			if (!is_red(sibling->tree_left) && !is_red(sibling->tree_right))
+			{
+				sibling->tree_red = true;
+				t = parent;
+				parent = t->tree_parent;
+				continue;
+			}
+
+			if (!is_red(sibling->tree_left))
+			{
+				sibling->tree_right->tree_red = false;
+				sibling->tree_red = true;
+				rotate_left(sibling);
+				sibling = parent->tree_left;
+			}
+			sibling->tree_red = parent->tree_red;
+			parent->tree_red = false;
+			sibling->tree_left->tree_red = false;
+			rotate_right(parent);
+			t = m_root;
+		}
+	}
+
+	if (nullptr != t)
+	{
+		t->tree_red = false;
+	}
+}
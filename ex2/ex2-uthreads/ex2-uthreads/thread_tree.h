@@ -0,0 +1,62 @@
+#ifndef THREAD_TREE_H
+#define THREAD_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class thread;
+
+/*
+ * A red-black tree of threads ordered by a key of theirs (e.g. thread::sched_vruntime), linked through
+ * the threads themselves (see thread::tree_parent/left/right), so inserting never allocates.
+ * Inserting and removing are O(log n), and the first thread (the lowest key) is kept at hand.
+ * Threads with the same key are kept in the order they were inserted.
+ * A thread may be in a single tree at a time, and its key must not change while it is in the tree.
+ */
+class thread_tree
+{
+public:
+	explicit thread_tree(uint64_t thread::* key);
+
+	thread_tree(const thread_tree&) = delete;
+	thread_tree& operator=(const thread_tree&) = delete;
+
+	bool empty() const { return nullptr == m_root; }
+	size_t size() const { return m_size; }
+	thread* front() const { return m_first; }
+
+	/**
+	 * @brief Returns the thread following the given one (which must be in the tree), or nullptr if it is the last.
+	 */
+	thread* next(thread* t) const;
+
+	void insert(thread* t);
+
+	/**
+	 * @brief Removes and returns the first thread in the tree, the tree must not be empty.
+	 */
+	thread* pop_front();
+
+	/**
+	 * @brief Removes the thread from the tree, if it is in it.
+	 * @return Whether the thread was in this tree.
+	 */
+	bool remove(thread* t);
+
+private:
+	// Links 'child' to 'parent' in place of 'old' (or as the root, if there is no parent)
+	void replace_child(thread* parent, thread* old, thread* child);
+	void rotate_left(thread* t);
+	void rotate_right(thread* t);
+	// Restores the red-black properties after inserting 't', or after removing a black node from
+	// the place of 't' (which may be nullptr, so its parent is given)
+	void insert_fixup(thread* t);
+	void remove_fixup(thread* t, thread* parent);
+
+	uint64_t thread::* const m_key;
+	thread* m_root;
+	thread* m_first;
+	size_t m_size;
+};
+
+#endif // THREAD_TREE_H
@@ -0,0 +1,164 @@
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <time.h>
+
+#include "trace.h"
+
+/* The time the rate of the timestamp counter is measured over, in nanoseconds */
+constexpr long long calibration_ns = 1000000;
+
+/* Returns the time of the monotonic clock, in nanoseconds */
+static long long monotonic_ns()
+{
+	struct timespec now = {};
+	(void)clock_gettime(CLOCK_MONOTONIC, &now);
+	return (static_cast<long long>(now.tv_sec) * 1000000000LL) + now.tv_nsec;
+}
+
+/* Returns the name of the reason, as shown in the trace */
+static const char* reason_name(trace_reason reason)
+{
+	switch (reason)
+	{
+	case TRACE_PREEMPTED:
+		return "preempted";
+	case TRACE_YIELDED:
+		return "yielded";
+	case TRACE_BLOCKED:
+		return "blocked";
+	case TRACE_SLEEPING:
+		return "sleeping";
+	case TRACE_WAITING:
+		return "waiting";
+	case TRACE_TERMINATED:
+		return "terminated";
+	case TRACE_IDLE:
+		return "idle";
+	}
+	return "unknown";
+}
+
+tsc_clock::tsc_clock() :
+	m_base_tsc(read_tsc()),
+	m_base_ns(monotonic_ns()),
+	m_ns_per_cycle(1.0)
+{}
+
+void tsc_clock::calibrate()
+{
+	uint64_t cycles = 0;
+	long long ns = 0;
+	do
+	{
+		cycles = read_tsc() - m_base_tsc;
+		ns = monotonic_ns() - m_base_ns;
+	} while (ns < calibration_ns);
+
+	if (0 != cycles)
+	{
+		m_ns_per_cycle = static_cast<double>(ns) / static_cast<double>(cycles);
+	}
+}
+
+trace_buffer::trace_buffer() :
+	m_recording(false),
+	m_events(),
+	m_mask(0),
+	m_recorded(0)
+{}
+
+void trace_buffer::start(size_t capacity)
+{
+	size_t size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	m_events.assign(size, trace_event{});
+	m_mask = size - 1;
+	m_recorded = 0;
+	m_recording = true;
+}
+
+std::vector<trace_event> trace_buffer::events() const
+{
+	const uint64_t first = dropped();
+	std::vector<trace_event> events;
+	events.reserve(static_cast<size_t>(m_recorded - first));
+	for (uint64_t i = first; i < m_recorded; i++)
+	{
+		events.push_back(m_events[i & m_mask]);
+	}
+	return events;
+}
+
+uint64_t trace_buffer::dropped() const
+{
+	return (m_recorded > m_events.size()) ? (m_recorded - m_events.size()) : 0;
+}
+
+/* Appends a slice of the thread running on the carrier to the trace */
+static void append_slice(std::string& json, int carrier, int tid, double start_us, double end_us, const char* reason)
+{
+	char slice[256];
+	(void)snprintf(slice, sizeof(slice),
+				   ",\n{\"name\":\"thread %d\",\"cat\":\"uthread\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+				   "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"uthread\":%d,\"switched_out\":\"%s\"}}",
+				   tid, carrier, start_us, end_us - start_us, tid, reason);
+	json += slice;
+}
+
+std::string format_chrome_trace(const std::vector<trace_event>& events, uint64_t dropped, uint64_t end_tsc,
+								const tsc_clock& clock)
+{
+	const double us_per_cycle = clock.ns_per_cycle() / 1000.0;
+	const uint64_t base_tsc = clock.base_tsc();
+	auto to_us = [us_per_cycle, base_tsc](uint64_t tsc)
+	{
+		return static_cast<double>(static_cast<int64_t>(tsc - base_tsc)) * us_per_cycle;
+	};
+
+	char header[256];
+	(void)snprintf(header, sizeof(header),
+				   "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_switches\":%" PRIu64 "},\"traceEvents\":[\n"
+				   "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"uthreads\"}}",
+				   dropped);
+	std::string json = header;
+
+	// The thread each carrier has switched to last (-1 for its idle loop), and when
+	std::map<int, trace_event> running;
+	for (const trace_event& event : events)
+	{
+		auto last = running.find(event.carrier);
+		if (running.end() == last)
+		{
+			char name[128];
+			(void)snprintf(name, sizeof(name),
+						   ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+						   "\"args\":{\"name\":\"carrier %d\"}}",
+						   event.carrier, event.carrier);
+			json += name;
+		}
+		// The slice of the thread switched from starts at the previous switch of the carrier (the first switch
+		// of a carrier in the buffer only starts a slice, as the previous one was overwritten)
+		else if ((-1 != event.from) && (last->second.to == event.from))
+		{
+			append_slice(json, event.carrier, event.from, to_us(last->second.tsc), to_us(event.tsc),
+						 reason_name(event.reason));
+		}
+		running[event.carrier] = event;
+	}
+
+	for (const auto& last : running)
+	{
+		if (-1 != last.second.to)
+		{
+			append_slice(json, last.first, last.second.to, to_us(last.second.tsc), to_us(end_tsc), "running");
+		}
+	}
+
+	json += "\n]}\n";
+	return json;
+}
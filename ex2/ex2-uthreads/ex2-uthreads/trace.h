@@ -0,0 +1,157 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/*
+ * Returns the timestamp counter of the CPU - The TSC is assumed to be invariant and synchronized between the
+ * cores (as on any recent x86 CPU), so timestamps taken on different carriers are comparable.
+ * Other architectures fall back to the monotonic clock, in nanoseconds.
+ */
+inline uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now = {};
+	(void)clock_gettime(CLOCK_MONOTONIC, &now);
+	return (static_cast<uint64_t>(now.tv_sec) * 1000000000ULL) + static_cast<uint64_t>(now.tv_nsec);
+#endif
+}
+
+/*
+ * Converts timestamp counter cycles to nanoseconds. The rate of the counter is measured once against the
+ * monotonic clock, so the same number of cycles is always converted to the same time.
+ */
+class tsc_clock
+{
+public:
+	tsc_clock();
+
+	/**
+	 * @brief Measures the rate of the counter since the converter was created, waiting until enough time has
+	 * passed for an accurate measurement (about a millisecond).
+	 */
+	void calibrate();
+
+	/**
+	 * @brief Returns the length of a cycle of the timestamp counter in nanoseconds, as measured by 'calibrate'.
+	 */
+	double ns_per_cycle() const { return m_ns_per_cycle; }
+
+	/**
+	 * @brief Returns the timestamp counter the converter was created at.
+	 */
+	uint64_t base_tsc() const { return m_base_tsc; }
+
+private:
+	const uint64_t m_base_tsc;
+	const long long m_base_ns;
+	double m_ns_per_cycle;
+};
+
+/* The reason a carrier has switched from one thread to another */
+enum trace_reason : uint8_t
+{
+	// The quantum of the thread has expired
+	TRACE_PREEMPTED,
+	// The thread has given up the rest of its quantum
+	TRACE_YIELDED,
+	// The thread was blocked (by uthread_block)
+	TRACE_BLOCKED,
+	// The thread went to sleep
+	TRACE_SLEEPING,
+	// The thread waits on a mutex, condition variable, channel, file descriptor or thread to join
+	TRACE_WAITING,
+	// The thread has terminated
+	TRACE_TERMINATED,
+	// The carrier had no thread to run, and a thread has become ready
+	TRACE_IDLE
+};
+
+/* A context switch of a carrier, the threads are -1 for the carrier's idle loop */
+struct trace_event
+{
+	uint64_t tsc;
+	int from;
+	int to;
+	int carrier;
+	trace_reason reason;
+};
+
+/*
+ * Ring buffer of the latest context switches, recording nothing until it is started.
+ * Requires the library's lock, as do the switches it records.
+ */
+class trace_buffer
+{
+public:
+	trace_buffer();
+
+	trace_buffer(const trace_buffer&) = delete;
+	trace_buffer& operator=(const trace_buffer&) = delete;
+
+	/**
+	 * @brief Starts recording the latest switches (at least 'capacity', rounded up to a power of 2),
+	 * discarding the recorded ones. Throws std::bad_alloc if the buffer cannot be allocated.
+	 */
+	void start(size_t capacity);
+
+	/**
+	 * @brief Stops recording, the recorded switches are kept.
+	 */
+	void stop() { m_recording = false; }
+
+	/**
+	 * @brief Returns whether switches are recorded, may be called without the library's lock.
+	 */
+	bool recording() const { return m_recording.load(std::memory_order_relaxed); }
+
+	void record(uint64_t tsc, int from, int to, int carrier, trace_reason reason)
+	{
+		if (!m_recording.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		m_events[m_recorded & m_mask] = trace_event{ tsc, from, to, carrier, reason };
+		m_recorded++;
+	}
+
+	/**
+	 * @brief Returns the recorded switches still in the buffer, the oldest first.
+	 */
+	std::vector<trace_event> events() const;
+
+	/**
+	 * @brief Returns the number of switches overwritten by later ones.
+	 */
+	uint64_t dropped() const;
+
+private:
+	std::atomic<bool> m_recording;
+	std::vector<trace_event> m_events;
+	size_t m_mask;
+	// The number of switches recorded since the buffer was started
+	uint64_t m_recorded;
+};
+
+/**
+ * @brief Formats the switches as a Chrome trace (the JSON trace event format, viewed in chrome://tracing or Perfetto),
+ * with each carrier as a track of the slices its threads have run for. The slices still running at 'end_tsc' end
+ * there.
+ */
+std::string format_chrome_trace(const std::vector<trace_event>& events, uint64_t dropped, uint64_t end_tsc,
+								const tsc_clock& clock);
+
+#endif // TRACE_H
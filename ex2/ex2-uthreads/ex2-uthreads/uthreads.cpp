@@ -1,13 +1,33 @@
 #include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
 #include <iostream>
+#include <limits>
+#include <linux/futex.h>
 #include <memory>
-#include <queue>
-#include <functional>
+#include <new>
+#include <pthread.h>
+#include <set>
 #include <signal.h>
-#include <sys/time.h>
-#include <numeric>
-
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "carrier.h"
+#include "cfs_policy.h"
+#include "edf_policy.h"
+#include "io_poller.h"
+#include "mlfq_policy.h"
+#include "rr_policy.h"
+#include "sleep_wheel.h"
+#include "spinlock.h"
+#include "stack_pool.h"
+#include "sync.h"
 #include "thread.h"
+#include "thread_table.h"
+#include "trace.h"
 #include "uthreads.h"
 
 /*
@@ -19,7 +39,28 @@
 /* Constants */
 constexpr uint32_t main_thread_id = 0;
 constexpr uint32_t usec_threshold = 1000000;
-using thread_id_queue = std::priority_queue<thread_id, std::vector<thread_id>, std::greater<thread_id>>;
+constexpr int max_io_events = 64;
+constexpr long long nsec_per_usec = 1000;
+constexpr long long nsec_per_msec = 1000000;
+// A timer expiring with less than this fraction of the quantum left ends it, rather than being set for the rest
+constexpr long long early_expiry_divisor = 8;
+// The real-time threads' utilization is in millionths of a carrier, and the total admitted is kept below a
+// whole carrier, leaving some time for the normal threads
+constexpr long long utilization_unit = 1000000;
+constexpr long long max_realtime_utilization = 950000;
+
+/* Enum for the reason the running thread is switched out */
+enum switch_reason : int
+{
+	// The quantum of the thread has expired
+	SWITCH_PREEMPTED,
+	// The thread has given up the rest of its quantum, and is still ready to run
+	SWITCH_YIELDED,
+	// The thread has blocked or went to sleep
+	SWITCH_BLOCKED,
+	// The thread has terminated itself
+	SWITCH_TERMINATED
+};
 
 /* Enum for the return status of the library functions */
 enum return_status : int
@@ -28,13 +69,6 @@ enum return_status : int
 	STATUS_SUCCESS = 0
 };
 
-/* Enum for the jump suspend state of the thread */
-enum suspend_state : int
-{
-	SUSPENDED,
-	RESUMED
-};
-
 /* Helper functions for printing errors */
 static void print_library_error(const std::string& msg)
 {
@@ -46,414 +80,2724 @@ static void print_system_error(const std::string& msg)
 	std::cerr << "system error: " << msg << std::endl;
 }
 
-/* RAII class for disabling and enabling context switching */
-class ctx_switch_lock
-{
-public:
-	ctx_switch_lock() { disable_ctx_switch(); }
-	~ctx_switch_lock() { enable_ctx_switch(); }
-
-	ctx_switch_lock(const ctx_switch_lock&) = delete;
-	ctx_switch_lock operator=(const ctx_switch_lock&) = delete;
-
-private:
-	static void disable_ctx_switch()
-	{
-		sigset_t sigset;
-		sigemptyset(&sigset);
-		sigaddset(&sigset, SIGVTALRM);
-		if (-1 == sigprocmask(SIG_BLOCK, &sigset, nullptr))
-		{
-			print_system_error("lock - failed to disable context switching");
-			exit(1);
-		}
-	}
-
-	static void enable_ctx_switch()
-	{
-		sigset_t sigset;
-		sigemptyset(&sigset);
-		sigaddset(&sigset, SIGVTALRM);
-		if (-1 == sigprocmask(SIG_UNBLOCK, &sigset, nullptr))
-		{
-			print_system_error("lock - failed to reenable context switching");
-			exit(1);
-		}
-	}
-};
-
 /* Manager for the user threads */
 class uthread_mgr
 {
 
 public:
 	uthread_mgr() :
+		lock(),
 		quantum_usecs_interval(0),
-		elapsed_quantums(0),
-		running_thread(0),
-		threads()
+		timer(UTHREAD_TIMER_VIRTUAL),
+		tickless(false),
+		carriers(),
+		threads(),
+		stacks(),
+		free_threads(),
+		sleeping_threads(2), // The first quantum to start after initialization is the second
+		timed_sleepers(),
+		has_quantum_waiters(false),
+		idle_carriers(0),
+		idle_epoch(0),
+		io(),
+		idle_polling(false),
+		trace(),
+		clock(),
+		realtime_utilization(0)
 	{}
 
+	// Guarding the manager's state and the BLOCKED threads, held by any library call along with the lock of its
+	// carrier (see ctx_switch_lock), and held across context switches - It is released by the thread switched to
+	spinlock lock;
 	int quantum_usecs_interval;
-	int elapsed_quantums;
-	thread_id_queue available_ids;
-	// Storing all the threads that are ready to run, as a queue,
-	// the threads will be run in a FIFO order
-	std::deque<thread_id> ready_threads;
-	// The current running thread
-	thread_id running_thread;
+	// The timer the quantums are measured by, and whether the carriers' timers are stopped
+	// while they aren't required (see uthread_set_timer)
+	uthread_timer timer;
+	bool tickless;
+	// The kernel threads running the user threads, each with its own ready threads
+	// (the policy decides on the order they are run in)
+	std::vector<std::unique_ptr<carrier>> carriers;
 	// Storing all the active threads (on all states)
-	thread* threads[MAX_THREAD_NUM];
-	// Storing all the threads marked for deletion
-	std::vector<thread_id> to_delete;
+	thread_table threads;
+	// The stacks of the threads, recycled as threads are deleted and spawned
+	stack_pool stacks;
+	// Deleted threads kept along with their stacks, by the size of their stacks - Spawning a thread
+	// reuses one of them if there is, rather than allocating a new thread and stack
+	std::unordered_map<size_t, std::vector<thread*>> free_threads;
+	// Storing all the sleeping threads by the quantum they wake up at,
+	// so only those which wake up are visited on each quantum
+	sleep_wheel sleeping_threads;
+	// Storing the threads sleeping in real time (see uthread_sleep_usecs) by the time they wake up at
+	std::set<std::pair<long long, thread*>> timed_sleepers;
+	// Whether threads sleep, waiting for quantums to pass - Updated as the lock is released, so the carriers
+	// switching threads without the lock know whether to take it (see quantum_waiters)
+	std::atomic<bool> has_quantum_waiters;
+	// Storing the threads which have terminated themselves, already erased from the thread table
+	// but deleted only once their stacks are no longer in use
+	std::vector<thread*> to_delete;
+	// The number of carriers waiting in their idle loop, and a futex word they wait on,
+	// changed whenever a thread becomes ready while there are idle carriers
+	std::atomic<int> idle_carriers;
+	std::atomic<int> idle_epoch;
+	// The threads waiting for file descriptors (guarded by the poller's own lock), and whether an idle carrier waits
+	// (outside of the locks) for them and for the next sleeping thread to wake up - Otherwise they are handled on
+	// each quantum
+	io_poller io;
+	std::atomic<bool> idle_polling;
+	// The latest context switches, recorded once tracing is started, and the clock their timestamps
+	// (and the run time of the threads) are converted by
+	trace_buffer trace;
+	tsc_clock clock;
+	// The total utilization of the real-time threads (see uthread_set_periodic), in millionths of a carrier
+	long long realtime_utilization;
 };
 
 static uthread_mgr g_mgr;
 
-/* Resets the timer to the quantum interval set in the manager */
-static void reset_timer()
+// The carrier of the calling kernel thread
+static thread_local carrier* t_current_carrier = nullptr;
+
+/*
+ * Returns the carrier of the calling kernel thread.
+ * A user thread may be resumed on another carrier after any context switch, so the address
+ * of the thread-local variable must be computed anew - Hence it is never inlined.
+ */
+__attribute__((noinline)) static carrier* current_carrier()
 {
-	// Setting up the timer
-	struct itimerval timer = { 0 };
-	timer.it_value.tv_sec = g_mgr.quantum_usecs_interval / usec_threshold;
-	timer.it_value.tv_usec = g_mgr.quantum_usecs_interval % usec_threshold;
-	timer.it_interval.tv_sec = g_mgr.quantum_usecs_interval / usec_threshold;
-	timer.it_interval.tv_usec = g_mgr.quantum_usecs_interval % usec_threshold;
+	asm volatile("" ::: "memory");
+	return t_current_carrier;
+}
 
-	if (-1 == setitimer(ITIMER_VIRTUAL, &timer, nullptr))
+/* Returns the thread running on the calling kernel thread */
+static thread* running_thread()
+{
+	return current_carrier()->running;
+}
+
+/* Blocks and unblocks the timer signal of the calling kernel thread */
+static void block_timer_signal(bool block)
+{
+	sigset_t sigset;
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGVTALRM);
+	if (0 != pthread_sigmask(block ? SIG_BLOCK : SIG_UNBLOCK, &sigset, nullptr))
 	{
-		print_system_error("init - timer setup failed");
+		print_system_error(block ? "lock - failed to disable context switching" :
+								   "lock - failed to reenable context switching");
 		exit(1);
 	}
 }
 
-/* Deletes a thread from the manager */
-static void delete_thread(thread_id tid)
-{
-	delete g_mgr.threads[tid];
-	g_mgr.threads[tid] = nullptr;
-	g_mgr.available_ids.push(tid);
-}
+static void take_deferred_preemption();
 
-static void switch_threads(bool is_blocked, bool terminate_running)
+/*
+ * Marks the calling carrier as running library code, so the timer signal doesn't preempt it (see
+ * sigvtalrm_handler) - Rather than blocking the signal, which takes a system call.
+ * Returns the carrier, which is the carrier the thread stays on until leave_library.
+ */
+static carrier* enter_library()
 {
-	const int paused = sigsetjmp(g_mgr.threads[g_mgr.running_thread]->env_blk, 1);
-	// The thread has been paused, we should switch to the next thread
-	// in the ready queue
-	if (suspend_state::SUSPENDED == paused)
+	while (true)
 	{
-		// Pushing the paused thread to the end of the queue, only if the switching
-		// was not triggered by a block
-		if (!is_blocked)
-		{
-			g_mgr.threads[g_mgr.running_thread]->state = READY;
-			g_mgr.ready_threads.push_back(g_mgr.running_thread);
-		}
-		else
-		{
-			// If the thread is being blocked, we reset the timer to allow
-			// full quantum for the next thread
-			reset_timer();
-			g_mgr.threads[g_mgr.running_thread]->state = BLOCKED;
-		}
+		carrier* const self = current_carrier();
+		self->in_library.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_signal_fence(std::memory_order_seq_cst);
 
-		if (terminate_running)
+		// The thread may have been preempted and resumed on another carrier before the mark was set,
+		// then it is taken back (the mark is a counter, so the other carrier's own marks are kept)
+		if (current_carrier() == self)
 		{
-			g_mgr.to_delete.push_back(g_mgr.running_thread);
+			return self;
 		}
+		self->in_library.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
 
-		g_mgr.running_thread = g_mgr.ready_threads.front(); // Getting the next thread to run
-		g_mgr.ready_threads.pop_front(); // Removing the thread from the queue
-
-		g_mgr.elapsed_quantums++;
-		g_mgr.threads[g_mgr.running_thread]->elapsed_quantums++;
-		g_mgr.threads[g_mgr.running_thread]->state = RUNNING;
+/* Unmarks the calling carrier as running library code, taking the preemption deferred meanwhile (if any) */
+static void leave_library()
+{
+	carrier* const self = current_carrier();
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	self->in_library.fetch_sub(1, std::memory_order_relaxed);
+	std::atomic_signal_fence(std::memory_order_seq_cst);
 
-		siglongjmp(g_mgr.threads[g_mgr.running_thread]->env_blk, RESUMED);
+	// A signal arriving once the mark is unset preempts the thread right away (clearing the pending preemption)
+	if (self->preempt_pending.load(std::memory_order_relaxed))
+	{
+		take_deferred_preemption();
 	}
 }
 
-static void handle_sleeper_threads()
+/*
+ * RAII class for running library code which doesn't access the manager's shared state,
+ * so the thread isn't switched out (or moved to another carrier) meanwhile.
+ */
+class library_section
 {
-	for (int it = 0; it < MAX_THREAD_NUM; it++)
+public:
+	library_section()
 	{
-		if (nullptr == g_mgr.threads[it])
-		{
-			continue;
-		}
+		(void)enter_library();
+	}
 
-		// Finding all the sleeping threads and decrementing their sleep time
-		if (0 != g_mgr.threads[it]->sleep_time)
-		{
-			g_mgr.threads[it]->sleep_time--;
-			// If the sleep time has passed, we should wake up the thread
-			// that is if and only if the thread is not blocked
-			// (if the thread is blocked, it will be woken up by uthread_resume)
-			if ((0 == g_mgr.threads[it]->sleep_time) && 
-				(!g_mgr.threads[it]->is_blocked))
-			{
-				g_mgr.threads[it]->state = READY;
-				g_mgr.ready_threads.push_back(it);
-			}
-		}
+	~library_section()
+	{
+		leave_library();
 	}
-}
 
-static void sigvtalrm_handler(int sig_num)
+	library_section(const library_section&) = delete;
+	library_section operator=(const library_section&) = delete;
+};
+
+/*
+ * The locks - Each carrier has a lock of its own, guarding its ready threads and the threads READY or RUNNING on it.
+ * Each synchronization primitive (and the I/O poller) has a lock of its own as well, guarding the threads waiting on
+ * it, while the manager's lock guards the rest (the thread table, and the other BLOCKED threads).
+ * A carrier switches between its threads (and steals the threads of other carriers) with only its own lock held,
+ * unless the switch requires the manager's lock as well (see lock_carrier) - So do the operations of the primitives,
+ * along with the primitive's lock (see object_lock). The other library calls hold both.
+ * The locks are taken in order: the manager's lock, the carrier's own lock, the lock of another carrier - Which
+ * only a holder of the manager's lock waits for, a carrier holding only its own lock merely tries it - and then
+ * the lock of a primitive (the lock of a condition variable before the lock of its mutex).
+ */
+
+/* Releases the manager's lock, noting whether threads sleep for the carriers switching without it */
+static void unlock_global()
 {
-	// Signal number is not used - We expect this function to be called only by the timer
+	g_mgr.has_quantum_waiters.store(!g_mgr.sleeping_threads.empty() || !g_mgr.timed_sleepers.empty(),
+									std::memory_order_relaxed);
+	g_mgr.lock.unlock();
+}
 
-	// Readying up the sleeper threads (if any)
-	handle_sleeper_threads();
+/* Returns whether threads wait for quantums to pass (sleeping threads, and threads waiting for file descriptors) */
+static bool quantum_waiters()
+{
+	return g_mgr.has_quantum_waiters.load(std::memory_order_relaxed) || g_mgr.io.has_waiters();
+}
 
-	// Switching to the next thread
-	switch_threads(false, false);
+/*
+ * Returns whether switching out the thread running on the carrier requires the manager's lock -
+ * If it was blocked or terminated by another carrier, or if the switches are traced.
+ */
+static bool switch_requires_global(const carrier* self)
+{
+	const thread* const running = self->running;
+	return g_mgr.trace.recording() || ((nullptr != running) && (running->terminate_pending || running->is_blocked));
 }
 
-int uthread_init(int quantum_usecs)
+/*
+ * Takes the lock of the carrier for switching its threads, along with the manager's lock if the switch requires it.
+ * While threads wait for quantums to pass, the manager's lock is taken too if it is free (so the switch readies up
+ * the threads which wake up), otherwise they are left to a later switch.
+ */
+static void lock_carrier(carrier* self)
 {
-	// Non-positive quantum_usecs is considered an error
-	if (quantum_usecs <= 0)
+	self->lock.lock();
+	if (switch_requires_global(self))
 	{
-		print_library_error("init - invalid quantum interval value");
-		return STATUS_FAILURE;
+		// Taking the locks in order - The running thread can't be blocked or terminated meanwhile, as it takes
+		// the carrier's lock
+		if (!g_mgr.lock.try_lock())
+		{
+			self->lock.unlock();
+			g_mgr.lock.lock();
+			self->lock.lock();
+		}
+		self->holds_global = true;
+		return;
 	}
 
-	g_mgr.quantum_usecs_interval = quantum_usecs;
-	g_mgr.elapsed_quantums = 1;
-
-	// Setting up the available thread IDs
-	std::vector<thread_id> available(MAX_THREAD_NUM-1);
-	std::iota(available.begin(), available.end(), 1);
-	g_mgr.available_ids = thread_id_queue(std::greater<thread_id>(), available);
+	self->holds_global = quantum_waiters() && g_mgr.lock.try_lock();
+}
 
-	// Setting up the main thread
-	thread* main_thread = nullptr;
-	try
-	{
-		main_thread = new thread(main_thread_id);
-	}
-	catch (const std::bad_alloc&)
+/*
+ * Releases the lock of the carrier, along with the manager's lock if it is held with it, and the lock handed over
+ * by the thread switched out last if it waits (see object_lock)
+ */
+static void unlock_carrier(carrier* self)
+{
+	spinlock* const handoff_lock = self->handoff_lock;
+	self->handoff_lock = nullptr;
+	if (nullptr != handoff_lock)
 	{
-		print_system_error("init - thread allocation failed");
-		exit(1);
+		handoff_lock->unlock();
 	}
 
-	g_mgr.threads[main_thread_id] = main_thread;
-	g_mgr.running_thread = main_thread_id;
-
-	// Setting up the sigaction associated with the timer
-	struct sigaction new_action = { 0 };
-	new_action.sa_handler = sigvtalrm_handler;
-
-	int sigset_retval = 0;
-	sigset_retval += sigemptyset(&new_action.sa_mask);
-	sigset_retval += sigaddset(&new_action.sa_mask, SIGVTALRM);
-	sigset_retval += sigaction(SIGVTALRM, &new_action, nullptr);
-	if (0 != sigset_retval)
+	const bool holds_global = self->holds_global;
+	self->holds_global = false;
+	self->lock.unlock();
+	if (holds_global)
 	{
-		print_system_error("init - failed to setup signal handling");
-		exit(1);
+		unlock_global();
 	}
-
-	// Setting up the timer
-	reset_timer();
-
-	return STATUS_SUCCESS;
 }
 
-int uthread_spawn(thread_entry_point entry_point)
+/*
+ * RAII class for disabling and enabling context switching -
+ * Marks the carrier as running library code (so it isn't preempted), and takes the manager's lock and its lock.
+ * The locks may be released by a different user thread (and on a different carrier) than the one
+ * which acquired them, as the locks are passed on by context switches - Along with the mark of the carrier.
+ */
+class ctx_switch_lock
 {
-	ctx_switch_lock mutex{};
-
-	// First, deleting all the threads which are done
-	for (const thread_id id : g_mgr.to_delete)
+public:
+	ctx_switch_lock()
 	{
-		delete_thread(id);
+		carrier* const self = enter_library();
+		g_mgr.lock.lock();
+		self->lock.lock();
+		self->holds_global = true;
 	}
-	g_mgr.to_delete.clear();
 
-	if (g_mgr.available_ids.empty())
+	~ctx_switch_lock()
 	{
-		print_library_error("spawn - maximum number of threads reached");
-		return STATUS_FAILURE;
+		unlock_carrier(current_carrier());
+		leave_library();
 	}
 
-	const thread_id tid = g_mgr.available_ids.top();
-	g_mgr.available_ids.pop();
+	ctx_switch_lock(const ctx_switch_lock&) = delete;
+	ctx_switch_lock operator=(const ctx_switch_lock&) = delete;
+};
 
-	// Creating the new thread
-	thread* new_thread = nullptr;
-	try
+/*
+ * RAII class for switching the running thread to another thread of the carrier, as ctx_switch_lock -
+ * Takes only the lock of the carrier, unless the switch requires the manager's lock as well (see lock_carrier).
+ */
+class carrier_switch_lock
+{
+public:
+	carrier_switch_lock()
 	{
-		new_thread = new thread(tid, entry_point);
+		lock_carrier(enter_library());
 	}
-	catch (const std::bad_alloc&)
+
+	~carrier_switch_lock()
 	{
-		print_system_error("spawn - thread allocation failed");
-		exit(1);
+		unlock_carrier(current_carrier());
+		leave_library();
 	}
 
-	// Mapping the new thread and marking it ready
-	g_mgr.threads[tid] = new_thread;
-	g_mgr.ready_threads.push_back(tid);
+	carrier_switch_lock(const carrier_switch_lock&) = delete;
+	carrier_switch_lock operator=(const carrier_switch_lock&) = delete;
+};
 
-	return tid;
-}
+static void switch_threads(switch_reason reason, thread* target = nullptr);
 
-int uthread_terminate(int tid)
+/* Prints a library error outside of any lock, in library code (so the thread isn't switched out while printing) */
+static void print_library_error_unlocked(const std::string& msg)
 {
-	ctx_switch_lock mutex{};
+	library_section section{};
+	print_library_error(msg);
+}
 
-	// If the requested thread to terminate is the main thread, we should exit the program
-	// as specified in the exercise. All the user threads will be deleted.
-	if (main_thread_id == tid)
+/*
+ * RAII class for operating on a synchronization primitive (or the I/O poller), guarded by a lock of its own -
+ * Takes the locks as carrier_switch_lock, and then the primitive's lock.
+ * A thread waiting on the primitive holds its lock until its context is saved, so it isn't woken up before that -
+ * The lock is handed to the thread switched to, which releases it along with the carrier's lock.
+ */
+class object_lock
+{
+public:
+	explicit object_lock(spinlock& lock) :
+		m_lock(lock),
+		m_held(true)
 	{
-		for (const thread* t : g_mgr.threads)
-		{
-			delete t;
-		}
-		exit(0);
+		lock_carrier(enter_library());
+		m_lock.lock();
 	}
 
-	auto thread = g_mgr.threads[tid];
-	if (nullptr == thread)
+	~object_lock()
 	{
-		print_library_error("terminate - thread id not found");
-		return STATUS_FAILURE;
+		if (m_held)
+		{
+			m_lock.unlock();
+		}
+		unlock_carrier(current_carrier());
+		leave_library();
 	}
 
-	// If the thread is running, we should switch to the next thread and erase this one
-	if (RUNNING == thread->state)
-	{
-		switch_threads(true, true);
-	}
+	object_lock(const object_lock&) = delete;
+	object_lock operator=(const object_lock&) = delete;
 
-	// If the thread is ready, we should erase it from the ready queue
-	if (READY == thread->state)
+	/**
+	 * @brief Blocks the running thread until it is woken up by wake_waiter, having queued it in the wait queue
+	 * (or registered it elsewhere under the lock, if there is no queue).
+	 */
+	void wait(thread_queue* waiters = nullptr)
 	{
-		const auto find_result =
-			std::find(g_mgr.ready_threads.begin(),
-					  g_mgr.ready_threads.end(),
-					  thread->id);
-		if (find_result != g_mgr.ready_threads.end())
+		thread* const self = running_thread();
+		self->is_waiting = true;
+		self->wait_lock.store(&m_lock, std::memory_order_relaxed);
+		if (nullptr != waiters)
 		{
-			g_mgr.ready_threads.erase(find_result);
+			waiters->push_back(self);
 		}
-	}
 
-	// We can safely do this here since we will reach here only if the thread is READY or BLOCKED
-	// (because on RUNNING, we will switch to another thread and never return here)
-	delete_thread(tid);
+		// The thread is resumed with the locks of the thread it is switched from instead
+		m_held = false;
+		current_carrier()->handoff_lock = &m_lock;
+		switch_threads(SWITCH_BLOCKED);
+	}
 
-	return STATUS_SUCCESS;
-}
+private:
+	spinlock& m_lock;
+	bool m_held;
+};
 
-int uthread_block(int tid)
+/*
+ * RAII class for locking the carrier a thread is READY or RUNNING on (or has last run on), so its scheduling state
+ * can be accessed - Taken within a ctx_switch_lock, which holds the calling carrier's lock already.
+ * If the thread waits on a synchronization primitive (or on a file descriptor), the primitive's lock is taken too,
+ * as the thread is woken up (and moved to the carrier waking it up) under that lock alone.
+ */
+class thread_carrier_lock
 {
-	ctx_switch_lock mutex{};
-
-	if (main_thread_id == tid)
+public:
+	explicit thread_carrier_lock(const thread* t) :
+		m_locked(nullptr),
+		m_wait_lock(nullptr)
 	{
-		print_library_error("block - cannot block the main thread");
-		return STATUS_FAILURE;
-	}
+		carrier* const self = current_carrier();
+		while (true)
+		{
+			carrier* const target = g_mgr.carriers[t->carrier_index.load(std::memory_order_relaxed)].get();
+			if (target != self)
+			{
+				// The thread may have been stolen by another carrier before the lock was taken
+				target->lock.lock();
+				if (target->index != t->carrier_index.load(std::memory_order_relaxed))
+				{
+					target->lock.unlock();
+					continue;
+				}
+				m_locked = target;
+			}
 
-	if (tid == g_mgr.running_thread)
-	{
-		// The running thread is blocking itself, we should switch to the next thread
-		g_mgr.threads[tid]->is_blocked = true;
-		switch_threads(true, false);
+			// The thread may have been woken up (or moved to another primitive) before the lock was taken -
+			// Then it may have been moved to another carrier as well, the lock is cleared only once it is
+			spinlock* const wait_lock = t->wait_lock.load(std::memory_order_acquire);
+			if (nullptr != wait_lock)
+			{
+				wait_lock->lock();
+				if (wait_lock == t->wait_lock.load(std::memory_order_relaxed))
+				{
+					m_wait_lock = wait_lock;
+					return;
+				}
+				wait_lock->unlock();
+			}
+			else if (target->index == t->carrier_index.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+
+			if (nullptr != m_locked)
+			{
+				m_locked->lock.unlock();
+				m_locked = nullptr;
+			}
+		}
 	}
-	else
+
+	~thread_carrier_lock()
 	{
-		// Looking up the thread
-		const auto thread = g_mgr.threads[tid];
-		if (nullptr == thread)
+		if (nullptr != m_wait_lock)
 		{
-			print_library_error("block - thread id not found");
-			return STATUS_FAILURE;
+			m_wait_lock->unlock();
 		}
 
-		// If the thread was found, looking for it in the ready queue and erasing it
-		const auto find_result =
-			std::find(g_mgr.ready_threads.begin(), g_mgr.ready_threads.end(), tid);
-		if (find_result != g_mgr.ready_threads.end())
+		if (nullptr != m_locked)
 		{
-			g_mgr.ready_threads.erase(find_result);
+			m_locked->lock.unlock();
 		}
-
-		g_mgr.threads[tid]->state = BLOCKED;
-		g_mgr.threads[tid]->is_blocked = true;
 	}
 
-	return STATUS_SUCCESS;
-}
+	thread_carrier_lock(const thread_carrier_lock&) = delete;
+	thread_carrier_lock operator=(const thread_carrier_lock&) = delete;
 
-int uthread_resume(int tid)
+private:
+	carrier* m_locked;
+	spinlock* m_wait_lock;
+};
+
+/* Wakes up a carrier waiting in its idle loop, if there is one */
+static void wake_idle_carrier()
 {
-	ctx_switch_lock mutex{};
+	if (0 == g_mgr.idle_carriers.load(std::memory_order_relaxed))
+	{
+		return;
+	}
 
-	// Looking up the thread
-	const auto thread = g_mgr.threads[tid];
-	if (nullptr == thread)
+	g_mgr.idle_epoch++;
+	(void)syscall(SYS_futex, reinterpret_cast<int*>(&g_mgr.idle_epoch), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	// The carrier waiting for file descriptors and sleeping threads doesn't wait on the futex
+	if (g_mgr.idle_polling)
 	{
-		print_library_error("resume - thread id not found");
-		return STATUS_FAILURE;
+		g_mgr.io.wake();
 	}
+}
 
-	// We resume the thread only if it is blocked and its sleep time has passed
-	// Therefore, resuming READY and RUNNING threads, or BLOCKED threads with
-	// remaining sleep time is not an error, and simply ignored.
-	if ((BLOCKED == thread->state) &&
-		(0 == thread->sleep_time))
+/* Wakes up the idle carrier waiting for sleeping threads (if any), as it may wait for too long */
+static void wake_idle_poller()
+{
+	if (g_mgr.idle_polling)
 	{
-		g_mgr.ready_threads.push_back(thread->id);
-		thread->state = READY;
+		g_mgr.io.wake();
 	}
+}
 
-	return STATUS_SUCCESS;
+/* Returns the time of the monotonic clock, in nanoseconds */
+static long long monotonic_ns()
+{
+	struct timespec now = {};
+	(void)clock_gettime(CLOCK_MONOTONIC, &now);
+	return (static_cast<long long>(now.tv_sec) * usec_threshold * nsec_per_usec) + now.tv_nsec;
 }
 
-int uthread_sleep(int num_quantums)
+/* Resets the timer of the carrier to the quantum interval set in the manager */
+static void reset_timer(carrier* target)
 {
-	ctx_switch_lock mutex{};
-	if (main_thread_id == g_mgr.running_thread)
+	if (!target->reset_timer(g_mgr.quantum_usecs_interval))
 	{
-		print_library_error("sleep - cannot sleep the main thread");
-		return STATUS_FAILURE;
+		print_system_error("init - timer setup failed");
+		exit(1);
 	}
+}
 
-	// Putting the thread to sleep
-	g_mgr.threads[g_mgr.running_thread]->sleep_time = num_quantums;
-	// Switching to the next thread
-	switch_threads(true, false);
-
-	return STATUS_SUCCESS;
+/* Returns the clock the carriers' own timers measure, see carrier::create_timer */
+static clockid_t timer_clock()
+{
+	return (UTHREAD_TIMER_MONOTONIC == g_mgr.timer) ? CLOCK_MONOTONIC : CLOCK_THREAD_CPUTIME_ID;
 }
 
-int uthread_get_tid()
+/* Stops the timer of the carrier, until it is reset */
+static void stop_timer(carrier* target)
 {
-	ctx_switch_lock mutex{};
-	return g_mgr.running_thread;
+	if (!target->stop_timer())
+	{
+		print_system_error("failed to stop a timer");
+		exit(1);
+	}
 }
 
-int uthread_get_total_quantums()
+/*
+ * Returns whether a tickless carrier requires its timer for the thread it runs - Only if another thread is
+ * ready to run on it, or if threads wait for quantums to pass (sleeping threads, and threads waiting for file
+ * descriptors, which are polled on each quantum).
+ */
+static bool needs_ticks(const carrier* self)
 {
-	ctx_switch_lock mutex{};
-	return g_mgr.elapsed_quantums;
+	return !self->policy->empty() || quantum_waiters();
 }
 
-int uthread_get_quantums(int tid)
+/*
+ * Sets the timer of the carrier as it switches to the next thread (or to its idle loop if there is none) -
+ * A running timer is left as is, even if the quantum has started by a switch rather than by the timer expiring
+ * (resetting it takes a system call), so it may expire before the quantum is up, see quantum_expired.
+ * The timer is stopped while the carrier is idle, and while a tickless carrier doesn't require it.
+ */
+static void update_timer(carrier* self, const thread* next)
 {
-	ctx_switch_lock mutex{};
+	if ((nullptr == next) || (g_mgr.tickless && !needs_ticks(self)))
+	{
+		if (self->timer_armed())
+		{
+			stop_timer(self);
+		}
+		return;
+	}
 
-	const auto thread = g_mgr.threads[tid];
-	if (nullptr == thread)
+	if (!self->timer_armed())
 	{
-		print_library_error("get_quantums - thread id not found");
-		return STATUS_FAILURE;
+		reset_timer(self);
 	}
+}
 
-	return thread->elapsed_quantums;
+/*
+ * Returns whether the running quantum of the carrier is up, as its timer expires - Otherwise the quantum has
+ * started by a switch since the timer was set, and the timer is set again to expire once the rest of it is up.
+ * The quantum is measured in real time by the timestamp counter, so for the CPU time timers it may be cut short
+ * by the time the carrier waited for a CPU - An expiry close enough to the end of the quantum ends it as well.
+ */
+static bool quantum_expired(carrier* self)
+{
+	const long long quantum_ns = g_mgr.quantum_usecs_interval * nsec_per_usec;
+	const long long elapsed_ns = static_cast<long long>(
+		static_cast<double>(read_tsc() - self->quantum_start_tsc) * g_mgr.clock.ns_per_cycle());
+	const long long left_ns = quantum_ns - elapsed_ns;
+	if (left_ns <= quantum_ns / early_expiry_divisor)
+	{
+		return true;
+	}
+
+	if (!self->reset_timer(g_mgr.quantum_usecs_interval, static_cast<int>(left_ns / nsec_per_usec)))
+	{
+		print_system_error("failed to set a timer");
+		exit(1);
+	}
+	return false;
+}
+
+/*
+ * Notes that threads wait for quantums to pass, restarting the stopped timers of the other tickless carriers
+ * running threads. Called with the lock held, as a thread starts waiting.
+ */
+static void start_ticking()
+{
+	g_mgr.has_quantum_waiters.store(true, std::memory_order_relaxed);
+	if (!g_mgr.tickless)
+	{
+		return;
+	}
+
+	carrier* const self = current_carrier();
+	for (const auto& other : g_mgr.carriers)
+	{
+		if (other.get() == self)
+		{
+			continue;
+		}
+
+		other->lock.lock();
+		if ((nullptr != other->running) && !other->timer_armed())
+		{
+			reset_timer(other.get());
+		}
+		other->lock.unlock();
+	}
+}
+
+/* Hands a thread which is ready to run to the policy of the carrier, with the carrier's lock held */
+static void make_ready(carrier* target, thread* t, ready_reason reason)
+{
+	t->state = READY;
+	t->carrier_index.store(target->index, std::memory_order_relaxed);
+	target->policy->enqueue(t, reason);
+	wake_idle_carrier();
+
+	// A tickless carrier running a thread alone starts ticking, so the thread gives way - Unless the thread
+	// is handed back by a switch, which sets the timer by itself
+	if (g_mgr.tickless && (READY_PREEMPTED != reason) && (READY_YIELDED != reason) &&
+		(nullptr != target->running) && !target->timer_armed())
+	{
+		reset_timer(target);
+	}
+}
+
+/* Removes a READY thread from the policy of the carrier it is queued on, with the carrier's lock held */
+static void remove_ready(thread* t)
+{
+	g_mgr.carriers[t->carrier_index.load(std::memory_order_relaxed)]->policy->remove(t);
+}
+
+/*
+ * Takes a READY thread out of the ready threads of the carrier it is queued on (locked by the caller), to run on the
+ * calling carrier - Moving it to the calling carrier if it is queued on another one.
+ */
+static void take_ready(carrier* self, thread* t)
+{
+	remove_ready(t);
+	if (t->carrier_index.load(std::memory_order_relaxed) != self->index)
+	{
+		t->carrier_index.store(self->index, std::memory_order_relaxed);
+		self->policy->adopt(t);
+	}
+}
+
+/* Returns the number of quantums started so far, on all the carriers */
+static int elapsed_quantums()
+{
+	long long total = 0;
+	for (const auto& c : g_mgr.carriers)
+	{
+		total += c->quantums.load(std::memory_order_relaxed);
+	}
+	return static_cast<int>(std::min(total, static_cast<long long>(std::numeric_limits<int>::max())));
+}
+
+/* Asks the carrier to reschedule its running thread (as it was blocked or terminated) */
+static void kick_carrier(carrier* target)
+{
+	target->kicked = true;
+	if (0 != pthread_kill(target->pthread, SIGVTALRM))
+	{
+		print_system_error("failed to signal a carrier");
+		exit(1);
+	}
+}
+
+/* The number of deleted threads kept for each stack size, any more are freed */
+constexpr size_t max_free_threads = 1024;
+
+/* Deletes a thread erased from the manager's thread table, keeping it for reuse by later spawns */
+static void delete_thread(thread* t)
+{
+	std::vector<thread*>& free_threads = g_mgr.free_threads[t->stack.size];
+	if (free_threads.size() < max_free_threads)
+	{
+		free_threads.push_back(t);
+		return;
+	}
+
+	g_mgr.stacks.release(t->stack);
+	delete t;
+}
+
+/*
+ * Readies up a thread which was taken out of a wait queue (or whose I/O is ready), unless it was blocked meanwhile.
+ * Called with the lock guarding what the thread waited on held, and the calling carrier's lock.
+ */
+static void wake_waiter(thread* waiter)
+{
+	waiter->is_waiting = false;
+	if (!waiter->is_blocked)
+	{
+		make_ready(current_carrier(), waiter, READY_WOKEN);
+	}
+	// Cleared only once the thread is moved to this carrier, see thread_carrier_lock
+	waiter->wait_lock.store(nullptr, std::memory_order_release);
+}
+
+/*
+ * Hands the result of a terminated thread to the threads joining it, waking them up.
+ * Returns whether the thread is kept as a ZOMBIE until it is joined, as no thread has joined it yet.
+ */
+static bool finish_thread(thread* t)
+{
+	// The time admitted for the thread as a real-time thread is available to others
+	g_mgr.realtime_utilization -= t->rt_utilization;
+	t->rt_utilization = 0;
+
+	if (t->joiners.empty())
+	{
+		return t->joinable;
+	}
+
+	while (!t->joiners.empty())
+	{
+		thread* const joiner = t->joiners.pop_front();
+		joiner->wait_item = t->result;
+		wake_waiter(joiner);
+	}
+	return false;
+}
+
+/* Readies up the threads which wake up on the given quantum, or on an earlier one */
+static void handle_sleeper_threads(carrier* self, int quantum)
+{
+	g_mgr.sleeping_threads.advance_to(quantum, [self](thread* sleeper)
+	{
+		sleeper->wake_quantum = 0;
+		// If the sleep time has passed, we should wake up the thread
+		// that is if and only if the thread is not blocked
+		// (if the thread is blocked, it will be woken up by uthread_resume)
+		if (!sleeper->is_blocked)
+		{
+			make_ready(self, sleeper, READY_WOKEN);
+		}
+	});
+}
+
+/*
+ * Readies up the threads whose file descriptors are ready, unless an idle carrier already waits for them -
+ * Or the poller's lock is taken (possibly by the thread switched out, as it starts waiting), then they are left
+ * to a later switch.
+ */
+static void handle_io_threads()
+{
+	if (g_mgr.idle_polling || !g_mgr.io.has_waiters() || !g_mgr.io.lock.try_lock())
+	{
+		return;
+	}
+
+	epoll_event events[max_io_events];
+	const int count = g_mgr.io.wait(events, max_io_events, 0);
+	g_mgr.io.dispatch(events, count, wake_waiter);
+	g_mgr.io.lock.unlock();
+}
+
+/* Readies up the threads sleeping in real time whose time has passed */
+static void handle_timed_sleepers()
+{
+	if (g_mgr.timed_sleepers.empty())
+	{
+		return;
+	}
+
+	const long long now = monotonic_ns();
+	while (!g_mgr.timed_sleepers.empty() && (g_mgr.timed_sleepers.begin()->first <= now))
+	{
+		thread* const sleeper = g_mgr.timed_sleepers.begin()->second;
+		g_mgr.timed_sleepers.erase(g_mgr.timed_sleepers.begin());
+		sleeper->wake_time = 0;
+		wake_waiter(sleeper);
+	}
+}
+
+/* Readies up the threads which wake up on the quantum about to start, or whose file descriptors are ready */
+static void handle_waking_threads(carrier* self)
+{
+	handle_sleeper_threads(self, elapsed_quantums() + 1);
+	handle_timed_sleepers();
+	handle_io_threads();
+}
+
+/*
+ * Returns the time (in milliseconds, rounded up) until the next sleeping thread wakes up, or -1 if there is none.
+ * While all the carriers are idle, quantums are counted by the time passed (see start_idle_quantums).
+ */
+static int idle_timeout_ms()
+{
+	long long timeout_ns = -1;
+
+	const int wake_quantum = g_mgr.sleeping_threads.next_wake_quantum();
+	if (-1 != wake_quantum)
+	{
+		timeout_ns = static_cast<long long>(wake_quantum - elapsed_quantums()) *
+					 g_mgr.quantum_usecs_interval * nsec_per_usec;
+	}
+
+	if (!g_mgr.timed_sleepers.empty())
+	{
+		const long long until_wake_ns = std::max(g_mgr.timed_sleepers.begin()->first - monotonic_ns(), 0LL);
+		timeout_ns = (-1 == timeout_ns) ? until_wake_ns : std::min(timeout_ns, until_wake_ns);
+	}
+
+	if (-1 == timeout_ns)
+	{
+		return -1;
+	}
+
+	return static_cast<int>(std::min((timeout_ns + nsec_per_msec - 1) / nsec_per_msec,
+									 static_cast<long long>(std::numeric_limits<int>::max())));
+}
+
+/*
+ * Starts the quantums which have passed while all the carriers were idle - No thread runs then, so a quantum
+ * is counted every quantum interval of real time, letting the sleeping threads wake up.
+ */
+static void start_idle_quantums(carrier* self, long long idle_ns)
+{
+	const long long quantums = idle_ns / (g_mgr.quantum_usecs_interval * nsec_per_usec);
+	if (0 == quantums)
+	{
+		return;
+	}
+
+	const long long max_quantums = std::numeric_limits<int>::max() - elapsed_quantums();
+	self->quantums.fetch_add(static_cast<int>(std::min(quantums, max_quantums)), std::memory_order_relaxed);
+	handle_sleeper_threads(self, elapsed_quantums());
+}
+
+/*
+ * Takes the next thread to run on the carrier out of its ready threads,
+ * or out of another carrier's if it has none. Returns nullptr if no thread is ready.
+ * The carriers whose lock is taken are skipped - They are busy switching, and run their ready threads themselves
+ * (whereas waiting for the lock of a carrier which switches between its threads rapidly may never end).
+ */
+static thread* take_next_thread(carrier* self)
+{
+	thread* next = self->policy->dequeue_next();
+	if (nullptr != next)
+	{
+		return next;
+	}
+
+	// Stealing from the other carriers, starting from the next one so the load is spread
+	const size_t count = g_mgr.carriers.size();
+	for (size_t offset = 1; offset < count; offset++)
+	{
+		carrier* const victim = g_mgr.carriers[(self->index + offset) % count].get();
+		if (!victim->lock.try_lock())
+		{
+			continue;
+		}
+
+		// The thread is moved before the victim's lock is released, so it is found on this carrier from then on
+		next = victim->policy->dequeue_next();
+		if (nullptr != next)
+		{
+			next->carrier_index.store(self->index, std::memory_order_relaxed);
+		}
+		victim->lock.unlock();
+
+		if (nullptr != next)
+		{
+			self->policy->adopt(next);
+			return next;
+		}
+	}
+
+	return nullptr;
+}
+
+/* Starts a new quantum of the thread on the carrier, at the given timestamp counter */
+static void start_quantum(carrier* self, thread* next, uint64_t now)
+{
+	next->run_start_tsc = now;
+	self->quantum_start_tsc = now;
+	self->policy->dispatch(next);
+	self->running = next;
+	self->quantums.fetch_add(1, std::memory_order_relaxed);
+	next->elapsed_quantums++;
+	next->state = RUNNING;
+}
+
+/* Returns the cycles the thread has run for, including its running quantum (if any) */
+static uint64_t total_run_cycles(const thread* t)
+{
+	if (RUNNING == t->state)
+	{
+		return t->run_cycles + (read_tsc() - t->run_start_tsc);
+	}
+	return t->run_cycles;
+}
+
+/*
+ * Removes a thread from the wait queue of the synchronization primitive it waits on (if any) -
+ * With the primitive's lock held, see thread_carrier_lock.
+ */
+static void stop_waiting(thread* t)
+{
+	if (!t->is_waiting)
+	{
+		return;
+	}
+	t->wait_lock.store(nullptr, std::memory_order_relaxed);
+
+	if (-1 != t->io_fd)
+	{
+		g_mgr.io.remove(t);
+	}
+	else if (0 != t->wake_time)
+	{
+		g_mgr.timed_sleepers.erase(std::make_pair(t->wake_time, t));
+		t->wake_time = 0;
+	}
+	else
+	{
+		(void)t->queue->remove(t);
+	}
+	t->is_waiting = false;
+}
+
+/* Returns the reason the thread is switched out for, as recorded in the trace */
+static trace_reason switch_trace_reason(switch_reason reason, const thread* paused)
+{
+	switch (reason)
+	{
+	case SWITCH_PREEMPTED:
+		return TRACE_PREEMPTED;
+	case SWITCH_YIELDED:
+		return TRACE_YIELDED;
+	case SWITCH_TERMINATED:
+		return TRACE_TERMINATED;
+	case SWITCH_BLOCKED:
+		break;
+	}
+
+	if ((0 != paused->wake_quantum) || (0 != paused->wake_time))
+	{
+		return TRACE_SLEEPING;
+	}
+	return paused->is_waiting ? TRACE_WAITING : TRACE_BLOCKED;
+}
+
+/* Records a switch of the carrier, only with the manager's lock held - Which is taken for every switch while tracing */
+static void trace_switch(const carrier* self, uint64_t now, int from, int to, trace_reason reason)
+{
+	if (self->holds_global)
+	{
+		g_mgr.trace.record(now, from, to, self->index, reason);
+	}
+}
+
+/*
+ * Switches from the running thread to the target thread, or to the next ready thread
+ * if there is no target (the target must be taken out of the ready threads, see take_ready).
+ * If no thread is ready, switches to the carrier's idle loop.
+ * Must be called with the carrier's lock held and the carrier marked as running library code - Along with the
+ * manager's lock, unless the thread is preempted or yields (see lock_carrier). The locks are released by the thread
+ * switched to, once the paused thread's context is saved (so another carrier can't resume it before that).
+ * Every point a thread resumes at is responsible to release the locks and unmark the carrier - Either the timer
+ * handler returning, a ctx_switch_lock (or carrier_switch_lock) releasing, thread_start or the idle loop.
+ */
+static void switch_threads(switch_reason reason, thread* target)
+{
+	carrier* const self = current_carrier();
+	thread* const paused = self->running;
+
+	// Applying the blocks and terminations requested by other carriers while the thread was running
+	if (paused->terminate_pending)
+	{
+		reason = SWITCH_TERMINATED;
+		if (0 != paused->wake_quantum)
+		{
+			g_mgr.sleeping_threads.remove(paused);
+			paused->wake_quantum = 0;
+		}
+		stop_waiting(paused);
+	}
+	else if (paused->is_blocked && ((SWITCH_PREEMPTED == reason) || (SWITCH_YIELDED == reason)))
+	{
+		reason = SWITCH_BLOCKED;
+	}
+
+	// The reason is taken before the threads which wake up are handled, as the paused thread may be one of them
+	const uint64_t now = read_tsc();
+	paused->run_cycles += now - paused->run_start_tsc;
+	const trace_reason traced_reason = switch_trace_reason(reason, paused);
+
+	// A new quantum starts, readying up the threads which wake up on it (if any) - Without the manager's lock,
+	// they are left to a later quantum
+	if (self->holds_global)
+	{
+		handle_waking_threads(self);
+	}
+
+	// Handing the paused thread back to the policy, only if it
+	// is still runnable
+	if ((SWITCH_PREEMPTED == reason) || (SWITCH_YIELDED == reason))
+	{
+		make_ready(self, paused, (SWITCH_PREEMPTED == reason) ? READY_PREEMPTED : READY_YIELDED);
+	}
+	else
+	{
+		paused->state = BLOCKED;
+	}
+
+	// The terminated thread can't be found by its ID anymore (so it isn't terminated again, and its ID may be
+	// reused), but it is deleted only after the switch, as its stack is still in use - Unless it is kept
+	// until it is joined, which happens after the switch
+	if (SWITCH_TERMINATED == reason)
+	{
+		if (finish_thread(paused))
+		{
+			paused->state = ZOMBIE;
+		}
+		else
+		{
+			g_mgr.threads.erase(paused->id);
+			g_mgr.to_delete.push_back(paused);
+		}
+	}
+
+	// Getting the next thread to run, and removing it from the ready threads
+	thread* next = target;
+	if (nullptr == next)
+	{
+		next = take_next_thread(self);
+	}
+
+	// The next thread is allowed a full quantum, see quantum_expired
+	update_timer(self, next);
+
+	// Returns once the paused thread is switched back to (possibly on another carrier)
+	if (nullptr == next)
+	{
+		trace_switch(self, now, paused->id, -1, traced_reason);
+		// The quantum the waking threads were handled for starts with the carrier idle, so threads sleep
+		// for as long while idle as they would while other threads run (see start_idle_quantums)
+		self->quantums.fetch_add(1, std::memory_order_relaxed);
+		self->running = nullptr;
+		context_switch(&paused->ctx, &self->idle_ctx);
+	}
+	else
+	{
+		trace_switch(self, now, paused->id, next->id, traced_reason);
+		start_quantum(self, next, now);
+		context_switch(&paused->ctx, &next->ctx);
+	}
+}
+
+/* Blocks the running thread in a wait queue guarded by the manager's lock, until it is woken up by wake_waiter */
+static void wait_in(thread_queue* waiters)
+{
+	thread* const self = running_thread();
+	self->is_waiting = true;
+	waiters->push_back(self);
+	switch_threads(SWITCH_BLOCKED);
+}
+
+/* Unlocks the mutex, handing it to the first thread waiting on it - With the mutex's lock held */
+static void release_mutex(uthread_mutex* mutex)
+{
+	if (mutex->waiters.empty())
+	{
+		mutex->state.store(0, std::memory_order_release);
+		return;
+	}
+
+	thread* const next = mutex->waiters.pop_front();
+	const uintptr_t has_waiters = mutex->waiters.empty() ? 0 : uthread_mutex::HAS_WAITERS;
+	mutex->state.store(reinterpret_cast<uintptr_t>(next) | has_waiters, std::memory_order_release);
+	wake_waiter(next);
+}
+
+/*
+ * Locks the mutex if it is unlocked, or marks it as waited on if it is held by another thread - With the mutex's
+ * lock held. Returns false if the running thread should wait for the mutex to be handed to it.
+ */
+static bool acquire_or_mark_mutex(uthread_mutex* mutex, thread* self)
+{
+	uintptr_t state = mutex->state.load(std::memory_order_relaxed);
+	while (true)
+	{
+		// The fast paths of the owner (unlocking it) and of other threads (locking it once it is unlocked) race this
+		const uintptr_t desired = (0 == state) ? reinterpret_cast<uintptr_t>(self) : (state | uthread_mutex::HAS_WAITERS);
+		if ((state == desired) ||
+			mutex->state.compare_exchange_weak(state, desired, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			return 0 == state;
+		}
+	}
+}
+
+/* The first function to run on a newly spawned thread */
+static void thread_start(void* arg)
+{
+	thread* const self = static_cast<thread*>(arg);
+
+	// The thread is started from switch_threads, which runs with the locks held in library code
+	unlock_carrier(current_carrier());
+	leave_library();
+
+	void* result = nullptr;
+	if (nullptr != self->entry_point_arg)
+	{
+		result = self->entry_point_arg(self->arg);
+	}
+	else
+	{
+		self->entry_point();
+	}
+
+	// Returning from the entry point is the same as terminating the thread, with the returned value as its result
+	{
+		ctx_switch_lock mutex{};
+		self->result = result;
+	}
+	uthread_terminate(self->id);
+}
+
+/* Creates a thread, reusing a deleted thread with a stack of the right size if there is */
+static thread* create_thread(thread_id tid, thread_entry_point entry_point, thread_entry_point_arg entry_point_arg,
+							 void* arg, int priority, size_t stack_size)
+{
+	auto free_threads = g_mgr.free_threads.find(g_mgr.stacks.stack_size(stack_size));
+	if ((g_mgr.free_threads.end() != free_threads) && !free_threads->second.empty())
+	{
+		thread* const t = free_threads->second.back();
+		free_threads->second.pop_back();
+
+		// Constructing the thread anew in place, keeping its stack
+		const thread_stack stack = t->stack;
+		t->~thread();
+		return new (t) thread(tid, entry_point, entry_point_arg, arg, thread_start, priority, stack);
+	}
+
+	const thread_stack stack = g_mgr.stacks.allocate(stack_size);
+	try
+	{
+		return new thread(tid, entry_point, entry_point_arg, arg, thread_start, priority, stack);
+	}
+	catch (const std::bad_alloc&)
+	{
+		g_mgr.stacks.release(stack);
+		throw;
+	}
+}
+
+/*
+ * Switches from the idle loop of the carrier to the thread taken out of the ready threads, with the carrier's lock
+ * held (see switch_threads). Returns (with the locks held again) once no thread is left for the carrier to run.
+ */
+static void run_from_idle(carrier* self, thread* next)
+{
+	// A new quantum starts, readying up the threads which wake up on it (if any)
+	if (self->holds_global)
+	{
+		handle_waking_threads(self);
+	}
+	update_timer(self, next);
+	const uint64_t now = read_tsc();
+	trace_switch(self, now, -1, next->id, TRACE_IDLE);
+	start_quantum(self, next, now);
+	context_switch(&self->idle_ctx, &next->ctx);
+}
+
+/*
+ * The loop a carrier runs whenever it has no thread to run - Runs the ready threads (of its own or
+ * stolen from other carriers) until there are none, and then waits for threads to become ready.
+ */
+static void carrier_loop(void* arg)
+{
+	carrier* const self = static_cast<carrier*>(arg);
+
+	while (true)
+	{
+		// Taking the manager's lock only once there seems to be no ready thread
+		{
+			carrier_switch_lock lock{};
+
+			thread* const next = take_next_thread(self);
+			if (nullptr != next)
+			{
+				run_from_idle(self, next);
+				continue;
+			}
+		}
+
+		int idle_epoch = 0;
+		bool poll = false;
+		int timeout_ms = -1;
+		long long idle_since = 0;
+		{
+			ctx_switch_lock mutex{};
+
+			// The carrier is counted as idle before looking for ready threads again, so a thread readied by another
+			// carrier once it was looked for wakes this one up
+			g_mgr.idle_carriers++;
+			idle_epoch = g_mgr.idle_epoch;
+
+			// A single idle carrier waits for the file descriptors threads wait on, and until the next
+			// sleeping thread wakes up - Woken up by wake_idle_carrier as well
+			poll = !g_mgr.idle_polling && (g_mgr.io.has_waiters() || !g_mgr.sleeping_threads.empty() ||
+										   !g_mgr.timed_sleepers.empty());
+			if (poll)
+			{
+				g_mgr.idle_polling = true;
+			}
+
+			thread* const next = take_next_thread(self);
+			if (nullptr != next)
+			{
+				if (poll)
+				{
+					g_mgr.idle_polling = false;
+				}
+				g_mgr.idle_carriers--;
+				run_from_idle(self, next);
+				continue;
+			}
+
+			if (poll)
+			{
+				timeout_ms = idle_timeout_ms();
+				idle_since = monotonic_ns();
+			}
+		}
+
+		if (poll)
+		{
+			epoll_event events[max_io_events];
+			const int count = g_mgr.io.wait(events, max_io_events, timeout_ms);
+
+			ctx_switch_lock mutex{};
+			g_mgr.idle_polling = false;
+			if (static_cast<int>(g_mgr.carriers.size()) == g_mgr.idle_carriers)
+			{
+				start_idle_quantums(self, monotonic_ns() - idle_since);
+			}
+			g_mgr.idle_carriers--;
+			g_mgr.io.lock.lock();
+			g_mgr.io.dispatch(events, count, wake_waiter);
+			g_mgr.io.lock.unlock();
+			handle_timed_sleepers();
+			continue;
+		}
+
+		// Waiting until a thread becomes ready (unless one became ready since the lock was released)
+		(void)syscall(SYS_futex, reinterpret_cast<int*>(&g_mgr.idle_epoch), FUTEX_WAIT_PRIVATE, idle_epoch,
+					  nullptr, nullptr, 0);
+		g_mgr.idle_carriers--;
+	}
+}
+
+/* The first function to run on the idle context of the first carrier */
+static void carrier_idle_start(void* arg)
+{
+	// The idle context is started from switch_threads, which runs with the locks held in library code
+	unlock_carrier(current_carrier());
+	leave_library();
+
+	carrier_loop(arg);
+}
+
+/* Entry point of the carriers created on initialization */
+static void* carrier_main(void* arg)
+{
+	carrier* const self = static_cast<carrier*>(arg);
+	t_current_carrier = self;
+
+	if (!self->create_timer(timer_clock()))
+	{
+		print_system_error("init - timer setup failed");
+		exit(1);
+	}
+
+	// The carrier is created with the timer signal blocked, until it can handle it
+	block_timer_signal(false);
+
+	carrier_loop(self);
+	return nullptr;
+}
+
+/*
+ * Preempts the thread running on the carrier, once its quantum has expired (by the policy), or once it was
+ * blocked or terminated by another carrier. Called with the carrier's lock held in library code, see lock_carrier.
+ */
+static void preempt_running(carrier* self)
+{
+	self->preempt_pending.store(false, std::memory_order_relaxed);
+
+	thread* const running = self->running;
+	const bool kicked = self->kicked.exchange(false);
+	if (nullptr != running)
+	{
+		if (running->terminate_pending || running->is_blocked)
+		{
+			// Another carrier has blocked or terminated the running thread
+			switch_threads(SWITCH_BLOCKED);
+		}
+		// The policy may let the running thread run for more than a single tick - Unless the timer has
+		// expired before the quantum is up, then the tick is taken once it is
+		else if (!kicked && quantum_expired(self) && self->policy->tick(running))
+		{
+			// Switching to the next thread
+			switch_threads(SWITCH_PREEMPTED);
+		}
+	}
+}
+
+/* Takes the preemption deferred by the timer signal, as it arrived while in library code */
+static void take_deferred_preemption()
+{
+	// The errno the library call has set is kept, see sigvtalrm_handler
+	const int saved_errno = errno;
+	carrier* const self = enter_library();
+	lock_carrier(self);
+
+	preempt_running(self);
+
+	// Returns once the thread is resumed, possibly on another carrier
+	unlock_carrier(current_carrier());
+	leave_library();
+	errno = saved_errno;
+}
+
+static void sigvtalrm_handler(int sig_num)
+{
+	// Signal number is not used - We expect this function to be called only by the timer,
+	// or by another carrier kicking this one
+
+	carrier* const self = current_carrier();
+	if ((nullptr == self) || (nullptr == self->running))
+	{
+		return;
+	}
+
+	// The carrier runs library code, which may hold the lock - Preempting once it is done
+	if (0 != self->in_library.load(std::memory_order_relaxed))
+	{
+		self->preempt_pending.store(true, std::memory_order_relaxed);
+		return;
+	}
+
+	// The signal isn't blocked while in the handler (so it can be taken again after switching threads
+	// within the handler), the carrier is marked as running library code instead
+	if (enter_library() != self)
+	{
+		// The signal has arrived again before the carrier was marked, and the thread was
+		// switched out and resumed on another carrier meanwhile
+		leave_library();
+		return;
+	}
+	// The errno of the interrupted thread is restored once it is resumed, as the threads
+	// switched to meanwhile (or the carrier it is resumed on, or waiting for the locks) have their own
+	const int saved_errno = errno;
+	lock_carrier(self);
+
+	preempt_running(self);
+
+	unlock_carrier(current_carrier());
+	leave_library();
+	errno = saved_errno;
+}
+
+/* Creates an instance of the scheduling policy for a carrier, running the real-time threads ahead of its threads */
+static sched_policy* create_policy(uthread_sched_policy policy)
+{
+	std::unique_ptr<sched_policy> normal;
+	switch (policy)
+	{
+	case UTHREAD_SCHED_MLFQ:
+		normal.reset(new mlfq_policy());
+		break;
+	case UTHREAD_SCHED_CFS:
+		normal.reset(new cfs_policy());
+		break;
+	case UTHREAD_SCHED_RR:
+		normal.reset(new rr_policy());
+		break;
+	}
+	return new edf_policy(std::move(normal));
+}
+
+int uthread_init(int quantum_usecs)
+{
+	return uthread_init_sched(quantum_usecs, UTHREAD_SCHED_RR);
+}
+
+int uthread_init_sched(int quantum_usecs, uthread_sched_policy policy)
+{
+	return uthread_init_carriers(quantum_usecs, policy, 1);
+}
+
+int uthread_init_carriers(int quantum_usecs, uthread_sched_policy policy, int num_carriers)
+{
+	// Non-positive quantum_usecs is considered an error
+	if (quantum_usecs <= 0)
+	{
+		print_library_error("init - invalid quantum interval value");
+		return STATUS_FAILURE;
+	}
+
+	if (num_carriers <= 0)
+	{
+		print_library_error("init - invalid number of carriers");
+		return STATUS_FAILURE;
+	}
+
+	if ((UTHREAD_SCHED_RR != policy) && (UTHREAD_SCHED_MLFQ != policy) && (UTHREAD_SCHED_CFS != policy))
+	{
+		print_library_error("init - invalid scheduling policy");
+		return STATUS_FAILURE;
+	}
+
+	g_mgr.quantum_usecs_interval = quantum_usecs;
+	g_mgr.clock.calibrate();
+
+	if (!g_mgr.io.create())
+	{
+		print_system_error("init - failed to create the I/O poller");
+		exit(1);
+	}
+
+	// Setting up the carriers, each with its own instance of the scheduling policy,
+	// and the main thread - As the first thread it is mapped to the main thread ID
+	thread* main_thread = nullptr;
+	try
+	{
+		for (int index = 0; index < num_carriers; index++)
+		{
+			g_mgr.carriers.emplace_back(new carrier(index, create_policy(policy)));
+		}
+
+		// The calling thread is the first carrier, its idle loop requires a stack of its own
+		// since the main thread runs on the calling thread's stack
+		g_mgr.carriers[0]->create_idle_context(carrier_idle_start);
+
+		main_thread = g_mgr.threads.insert([](thread_id tid) { return new thread(tid); });
+	}
+	catch (const std::bad_alloc&)
+	{
+		print_system_error("init - thread allocation failed");
+		exit(1);
+	}
+
+	// The main thread's quantum is the first one
+	carrier* const first = g_mgr.carriers[0].get();
+	t_current_carrier = first;
+	first->quantums = 1;
+	first->running = main_thread;
+	first->policy->dispatch(main_thread);
+
+	// Setting up the sigaction associated with the timer
+	struct sigaction new_action = { 0 };
+	new_action.sa_handler = sigvtalrm_handler;
+	// The handler may switch threads, and the thread switched to doesn't return from it - So the signal
+	// must not be blocked while in the handler, it is deferred by the carrier's in_library mark instead.
+	// A real time timer may expire while a thread waits in a system call, which is restarted then.
+	new_action.sa_flags = SA_NODEFER | SA_RESTART;
+
+	int sigset_retval = 0;
+	sigset_retval += sigemptyset(&new_action.sa_mask);
+	sigset_retval += sigaction(SIGVTALRM, &new_action, nullptr);
+	if (0 != sigset_retval)
+	{
+		print_system_error("init - failed to setup signal handling");
+		exit(1);
+	}
+
+	// With a single carrier, the process-wide virtual timer is used as is (by default).
+	// Otherwise each carrier has a timer of its own, on its own CPU time or on real time.
+	if (((num_carriers > 1) || (UTHREAD_TIMER_VIRTUAL != g_mgr.timer)) && !first->create_timer(timer_clock()))
+	{
+		print_system_error("init - timer setup failed");
+		exit(1);
+	}
+
+	// Setting up the timer
+	first->quantum_start_tsc = read_tsc();
+	update_timer(first, main_thread);
+
+	// Starting up the other carriers, with the timer signal blocked until they run a thread
+	block_timer_signal(true);
+	for (int index = 1; index < num_carriers; index++)
+	{
+		carrier* const other = g_mgr.carriers[index].get();
+		if (0 != pthread_create(&other->pthread, nullptr, carrier_main, other))
+		{
+			print_system_error("init - failed to create a carrier");
+			exit(1);
+		}
+	}
+	block_timer_signal(false);
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_set_timer(uthread_timer timer, int flags)
+{
+	// The library isn't initialized yet, so there is no lock to take
+	if (0 != g_mgr.quantum_usecs_interval)
+	{
+		print_library_error("set_timer - the library is already initialized");
+		return STATUS_FAILURE;
+	}
+
+	if ((UTHREAD_TIMER_VIRTUAL != timer) && (UTHREAD_TIMER_THREAD_CPU != timer) && (UTHREAD_TIMER_MONOTONIC != timer))
+	{
+		print_library_error("set_timer - invalid timer");
+		return STATUS_FAILURE;
+	}
+
+	if (0 != (flags & ~UTHREAD_TIMER_TICKLESS))
+	{
+		print_library_error("set_timer - invalid flags");
+		return STATUS_FAILURE;
+	}
+
+	g_mgr.timer = timer;
+	g_mgr.tickless = (0 != (flags & UTHREAD_TIMER_TICKLESS));
+	return STATUS_SUCCESS;
+}
+
+int uthread_set_stack_guard(int enabled)
+{
+	// The library isn't initialized yet, so there is no lock to take
+	if (0 != g_mgr.quantum_usecs_interval)
+	{
+		print_library_error("set_stack_guard - the library is already initialized");
+		return STATUS_FAILURE;
+	}
+
+	g_mgr.stacks.set_guarded(0 != enabled);
+	return STATUS_SUCCESS;
+}
+
+int uthread_spawn(thread_entry_point entry_point)
+{
+	return uthread_spawn_prio(entry_point, 0);
+}
+
+int uthread_spawn_prio(thread_entry_point entry_point, int priority)
+{
+	return uthread_spawn_stack(entry_point, priority, STACK_SIZE);
+}
+
+/* Creates a thread running either entry_point, or entry_point_arg with arg (then the thread is joinable) */
+static int spawn_thread(thread_entry_point entry_point, thread_entry_point_arg entry_point_arg, void* arg,
+						int priority, int stack_size)
+{
+	ctx_switch_lock mutex{};
+
+	if ((nullptr == entry_point) && (nullptr == entry_point_arg))
+	{
+		print_library_error("spawn - invalid entry point");
+		return STATUS_FAILURE;
+	}
+
+	if ((priority < 0) || (priority >= PRIORITY_LEVELS))
+	{
+		print_library_error("spawn - invalid priority");
+		return STATUS_FAILURE;
+	}
+
+	if (stack_size <= 0)
+	{
+		print_library_error("spawn - invalid stack size");
+		return STATUS_FAILURE;
+	}
+
+	// First, deleting all the threads which are done
+	for (thread* const t : g_mgr.to_delete)
+	{
+		delete_thread(t);
+	}
+	g_mgr.to_delete.clear();
+
+	// Creating the new thread and mapping it
+	thread* new_thread = nullptr;
+	try
+	{
+		new_thread = g_mgr.threads.insert(
+			[entry_point, entry_point_arg, arg, priority, stack_size](thread_id tid)
+			{
+				return create_thread(tid, entry_point, entry_point_arg, arg, priority, static_cast<size_t>(stack_size));
+			});
+	}
+	catch (const stack_map_error&)
+	{
+		// Out of memory mappings (or address space) rather than memory - The threads which exist keep running
+		print_library_error("spawn - stack allocation failed");
+		return STATUS_FAILURE;
+	}
+	catch (const std::bad_alloc&)
+	{
+		print_system_error("spawn - thread allocation failed");
+		exit(1);
+	}
+
+	// Marking the new thread ready, on the spawning thread's carrier
+	make_ready(current_carrier(), new_thread, READY_SPAWNED);
+
+	return new_thread->id;
+}
+
+int uthread_spawn_stack(thread_entry_point entry_point, int priority, int stack_size)
+{
+	return spawn_thread(entry_point, nullptr, nullptr, priority, stack_size);
+}
+
+int uthread_spawn_arg(thread_entry_point_arg entry_point, void* arg)
+{
+	return spawn_thread(nullptr, entry_point, arg, 0, STACK_SIZE);
+}
+
+int uthread_set_weight(int tid, int weight)
+{
+	ctx_switch_lock mutex{};
+
+	if (weight <= 0)
+	{
+		print_library_error("set_weight - invalid weight");
+		return STATUS_FAILURE;
+	}
+
+	const auto thread = g_mgr.threads.get(tid);
+	if (nullptr == thread)
+	{
+		print_library_error("set_weight - thread id not found");
+		return STATUS_FAILURE;
+	}
+	thread_carrier_lock carrier_lock(thread);
+
+	// The time the thread has run for so far is counted by the previous weight (a READY thread was
+	// counted once it was queued, so its place in the queue is kept)
+	if (READY != thread->state)
+	{
+		cfs_policy::charge(thread, total_run_cycles(thread));
+	}
+	thread->sched_weight = weight;
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_terminate(int tid)
+{
+	ctx_switch_lock mutex{};
+
+	// If the requested thread to terminate is the main thread, we should exit the program
+	// as specified in the exercise. All the user threads will be deleted - Unless other carriers
+	// may still be running threads on their stacks, then exiting reclaims them.
+	if (main_thread_id == tid)
+	{
+		if (1 == g_mgr.carriers.size())
+		{
+			g_mgr.threads.for_each([](const thread* t) { delete t; });
+		}
+		exit(0);
+	}
+
+	auto thread = g_mgr.threads.get(tid);
+	if (nullptr == thread)
+	{
+		print_library_error("terminate - thread id not found");
+		return STATUS_FAILURE;
+	}
+	thread_carrier_lock carrier_lock(thread);
+
+	// A thread which has already terminated is released without being joined
+	if (ZOMBIE == thread->state)
+	{
+		g_mgr.threads.erase(tid);
+		delete_thread(thread);
+		return STATUS_SUCCESS;
+	}
+
+	if (0 != thread->wake_quantum)
+	{
+		g_mgr.sleeping_threads.remove(thread);
+	}
+	stop_waiting(thread);
+
+	// If the thread is running, we should switch to the next thread and erase this one
+	if (thread == running_thread())
+	{
+		switch_threads(SWITCH_TERMINATED);
+	}
+
+	// If the thread is running on another carrier, it is erased once that carrier switches it out
+	if (RUNNING == thread->state)
+	{
+		thread->terminate_pending = true;
+		kick_carrier(g_mgr.carriers[thread->carrier_index.load(std::memory_order_relaxed)].get());
+		return STATUS_SUCCESS;
+	}
+
+	// If the thread is ready, we should erase it from the ready queue
+	if (READY == thread->state)
+	{
+		remove_ready(thread);
+	}
+
+	if (finish_thread(thread))
+	{
+		thread->state = ZOMBIE;
+		return STATUS_SUCCESS;
+	}
+
+	// We can safely do this here since we will reach here only if the thread is READY or BLOCKED
+	// (because on RUNNING, we will switch to another thread and never return here)
+	g_mgr.threads.erase(tid);
+	delete_thread(thread);
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_join(int tid, void** result)
+{
+	ctx_switch_lock mutex{};
+
+	thread* const target = g_mgr.threads.get(tid);
+	if (nullptr == target)
+	{
+		print_library_error("join - thread id not found");
+		return STATUS_FAILURE;
+	}
+
+	if (!target->joinable)
+	{
+		print_library_error("join - thread isn't joinable");
+		return STATUS_FAILURE;
+	}
+
+	thread* const self = running_thread();
+	if (target == self)
+	{
+		print_library_error("join - a thread cannot join itself");
+		return STATUS_FAILURE;
+	}
+
+	bool terminated = false;
+	{
+		thread_carrier_lock carrier_lock(target);
+		terminated = (ZOMBIE == target->state);
+	}
+
+	void* value = nullptr;
+	if (terminated)
+	{
+		// The thread has terminated already, and is released once its result is taken
+		value = target->result;
+		g_mgr.threads.erase(tid);
+		delete_thread(target);
+	}
+	else
+	{
+		// The result is handed to the thread before it is woken up, see finish_thread
+		wait_in(&target->joiners);
+		value = self->wait_item;
+	}
+
+	if (nullptr != result)
+	{
+		*result = value;
+	}
+	return STATUS_SUCCESS;
+}
+
+int uthread_block(int tid)
+{
+	ctx_switch_lock mutex{};
+
+	if (main_thread_id == tid)
+	{
+		print_library_error("block - cannot block the main thread");
+		return STATUS_FAILURE;
+	}
+
+	thread* const running = running_thread();
+	if (tid == running->id)
+	{
+		// The running thread is blocking itself, we should switch to the next thread
+		running->is_blocked = true;
+		switch_threads(SWITCH_BLOCKED);
+	}
+	else
+	{
+		// Looking up the thread
+		const auto thread = g_mgr.threads.get(tid);
+		if (nullptr == thread)
+		{
+			print_library_error("block - thread id not found");
+			return STATUS_FAILURE;
+		}
+		thread_carrier_lock carrier_lock(thread);
+
+		// A thread which has terminated (and waits to be joined) is left as is
+		if (ZOMBIE == thread->state)
+		{
+			return STATUS_SUCCESS;
+		}
+
+		thread->is_blocked = true;
+
+		// If the thread is running on another carrier, that carrier switches it out
+		if (RUNNING == thread->state)
+		{
+			kick_carrier(g_mgr.carriers[thread->carrier_index.load(std::memory_order_relaxed)].get());
+			return STATUS_SUCCESS;
+		}
+
+		// If the thread was found, erasing it from the ready queue (if it is there)
+		if (READY == thread->state)
+		{
+			remove_ready(thread);
+		}
+
+		thread->state = BLOCKED;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_resume(int tid)
+{
+	ctx_switch_lock mutex{};
+
+	// Looking up the thread
+	const auto thread = g_mgr.threads.get(tid);
+	if (nullptr == thread)
+	{
+		print_library_error("resume - thread id not found");
+		return STATUS_FAILURE;
+	}
+	thread_carrier_lock carrier_lock(thread);
+
+	// The thread is no longer blocked, even if it still has remaining sleep time
+	// (then it is woken up once the sleep time passes)
+	thread->is_blocked = false;
+
+	// We resume the thread only if it is blocked, its sleep time has passed and it doesn't wait on
+	// a synchronization primitive. Therefore, resuming READY and RUNNING threads, or BLOCKED threads
+	// with remaining sleep time or which wait is not an error, and simply ignored.
+	if ((BLOCKED == thread->state) &&
+		(0 == thread->wake_quantum) &&
+		!thread->is_waiting)
+	{
+		make_ready(current_carrier(), thread, READY_WOKEN);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_sleep(int num_quantums)
+{
+	ctx_switch_lock mutex{};
+	thread* const sleeper = running_thread();
+	if (main_thread_id == sleeper->id)
+	{
+		print_library_error("sleep - cannot sleep the main thread");
+		return STATUS_FAILURE;
+	}
+
+	if (num_quantums <= 0)
+	{
+		print_library_error("sleep - invalid number of quantums");
+		return STATUS_FAILURE;
+	}
+
+	// Putting the thread to sleep - The current quantum isn't counted, so the thread wakes up
+	// once num_quantums quantums have started after it
+	sleeper->wake_quantum = elapsed_quantums() + num_quantums + 1;
+	g_mgr.sleeping_threads.add(sleeper);
+	wake_idle_poller();
+	start_ticking();
+	// Switching to the next thread
+	switch_threads(SWITCH_BLOCKED);
+
+	return STATUS_SUCCESS;
+}
+
+/*
+ * Blocks the running thread until the given time of the monotonic clock (in nanoseconds), it is woken up on the
+ * first quantum which starts after it. Called with the lock held, as switch_threads.
+ */
+static void sleep_until(long long wake_time)
+{
+	thread* const sleeper = running_thread();
+	sleeper->wake_time = wake_time;
+	try
+	{
+		g_mgr.timed_sleepers.insert(std::make_pair(sleeper->wake_time, sleeper));
+	}
+	catch (const std::bad_alloc&)
+	{
+		print_system_error("sleep_usecs - allocation failed");
+		exit(1);
+	}
+	wake_idle_poller();
+	start_ticking();
+
+	// The thread waits like a thread waiting on a synchronization primitive, so it is woken up by wake_waiter
+	sleeper->is_waiting = true;
+	switch_threads(SWITCH_BLOCKED);
+}
+
+int uthread_sleep_usecs(int usecs)
+{
+	ctx_switch_lock mutex{};
+
+	if (usecs <= 0)
+	{
+		print_library_error("sleep_usecs - invalid sleep time");
+		return STATUS_FAILURE;
+	}
+
+	sleep_until(monotonic_ns() + (usecs * nsec_per_usec));
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_set_periodic(int tid, int period_usecs, int budget_usecs)
+{
+	ctx_switch_lock mutex{};
+
+	if ((period_usecs < 0) || ((0 != period_usecs) && ((budget_usecs <= 0) || (budget_usecs > period_usecs))))
+	{
+		print_library_error("set_periodic - invalid period or budget");
+		return STATUS_FAILURE;
+	}
+
+	const auto thread = g_mgr.threads.get(tid);
+	if (nullptr == thread)
+	{
+		print_library_error("set_periodic - thread id not found");
+		return STATUS_FAILURE;
+	}
+
+	thread_carrier_lock carrier_lock(thread);
+	if (ZOMBIE == thread->state)
+	{
+		print_library_error("set_periodic - thread id not found");
+		return STATUS_FAILURE;
+	}
+
+	// Admitting the thread only if the real-time threads can still meet all their deadlines (by EDF)
+	// with some time left for the normal threads - Rounding the utilization up
+	const long long utilization = (0 == period_usecs) ? 0 :
+		((budget_usecs * utilization_unit) + period_usecs - 1) / period_usecs;
+	if (g_mgr.realtime_utilization - thread->rt_utilization + utilization > max_realtime_utilization)
+	{
+		print_library_error("set_periodic - not enough time left for the real-time threads");
+		return STATUS_FAILURE;
+	}
+
+	// A queued thread is queued again by its new class
+	const bool ready = (READY == thread->state);
+	if (ready)
+	{
+		remove_ready(thread);
+	}
+
+	g_mgr.realtime_utilization += utilization - thread->rt_utilization;
+	thread->rt_utilization = utilization;
+	thread->rt_period_ns = period_usecs * nsec_per_usec;
+	thread->rt_budget_cycles =
+		static_cast<uint64_t>(static_cast<double>(budget_usecs * nsec_per_usec) / g_mgr.clock.ns_per_cycle());
+	// The first job is released right away
+	thread->rt_deadline = static_cast<uint64_t>(monotonic_ns() + thread->rt_period_ns);
+	thread->rt_job_start_cycles = total_run_cycles(thread);
+	thread->rt_throttled = false;
+	thread->rt_misses = 0;
+
+	if (ready)
+	{
+		make_ready(g_mgr.carriers[thread->carrier_index.load(std::memory_order_relaxed)].get(), thread, READY_WOKEN);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_wait_next_period()
+{
+	ctx_switch_lock mutex{};
+
+	thread* const self = running_thread();
+	if (0 == self->rt_period_ns)
+	{
+		print_library_error("wait_next_period - the thread isn't periodic");
+		return STATUS_FAILURE;
+	}
+
+	const long long period = self->rt_period_ns;
+	const long long deadline = static_cast<long long>(self->rt_deadline);
+	const long long now = monotonic_ns();
+	self->rt_throttled = false;
+	if (now <= deadline)
+	{
+		// The job is done in time, the next one is released once its period starts (at the deadline of this one)
+		self->rt_deadline = static_cast<uint64_t>(deadline + period);
+		sleep_until(deadline);
+	}
+	else
+	{
+		// The job has missed its deadline, and so have the jobs of the periods which have passed since - The next
+		// job is released right away, in the current period
+		const long long missed = ((now - deadline) / period) + 1;
+		self->rt_misses += static_cast<int>(std::min(missed, static_cast<long long>(std::numeric_limits<int>::max())));
+		self->rt_deadline = static_cast<uint64_t>(deadline + (missed * period));
+	}
+	self->rt_job_start_cycles = total_run_cycles(self);
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_get_deadline_misses(int tid)
+{
+	ctx_switch_lock mutex{};
+
+	const auto thread = g_mgr.threads.get(tid);
+	if (nullptr == thread)
+	{
+		print_library_error("get_deadline_misses - thread id not found");
+		return STATUS_FAILURE;
+	}
+	thread_carrier_lock carrier_lock(thread);
+
+	return thread->rt_misses;
+}
+
+int uthread_yield()
+{
+	carrier_switch_lock lock{};
+
+	// Switching to the next thread, this thread is queued to the end of the ready queue
+	switch_threads(SWITCH_YIELDED);
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_switch_to(int tid)
+{
+	ctx_switch_lock mutex{};
+
+	// Looking up the thread
+	const auto thread = g_mgr.threads.get(tid);
+	if (nullptr == thread)
+	{
+		print_library_error("switch_to - thread id not found");
+		return STATUS_FAILURE;
+	}
+
+	// Switching to the running thread itself has no effect
+	if (thread == running_thread())
+	{
+		return STATUS_SUCCESS;
+	}
+
+	{
+		thread_carrier_lock carrier_lock(thread);
+
+		// (including a thread running on another carrier)
+		if (READY != thread->state)
+		{
+			print_library_error("switch_to - thread is not ready");
+			return STATUS_FAILURE;
+		}
+		take_ready(current_carrier(), thread);
+	}
+
+	// Handing the rest of the CPU directly to the thread,
+	// this thread is queued to the end of the ready queue
+	switch_threads(SWITCH_YIELDED, thread);
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_get_tid()
+{
+	library_section section{};
+	return running_thread()->id;
+}
+
+int uthread_get_total_quantums()
+{
+	library_section section{};
+	return elapsed_quantums();
+}
+
+int uthread_get_quantums(int tid)
+{
+	ctx_switch_lock mutex{};
+
+	const auto thread = g_mgr.threads.get(tid);
+	if (nullptr == thread)
+	{
+		print_library_error("get_quantums - thread id not found");
+		return STATUS_FAILURE;
+	}
+	thread_carrier_lock carrier_lock(thread);
+
+	return thread->elapsed_quantums;
+}
+
+long long uthread_get_runtime_nsecs(int tid)
+{
+	uint64_t run_cycles = 0;
+	{
+		ctx_switch_lock mutex{};
+
+		const auto thread = g_mgr.threads.get(tid);
+		if (nullptr == thread)
+		{
+			print_library_error("get_runtime_nsecs - thread id not found");
+			return STATUS_FAILURE;
+		}
+		thread_carrier_lock carrier_lock(thread);
+
+		run_cycles = total_run_cycles(thread);
+	}
+
+	return static_cast<long long>(static_cast<double>(run_cycles) * g_mgr.clock.ns_per_cycle());
+}
+
+int uthread_trace_start(int capacity)
+{
+	ctx_switch_lock mutex{};
+
+	if (capacity <= 0)
+	{
+		print_library_error("trace_start - invalid capacity");
+		return STATUS_FAILURE;
+	}
+
+	try
+	{
+		g_mgr.trace.start(static_cast<size_t>(capacity));
+	}
+	catch (const std::bad_alloc&)
+	{
+		print_system_error("trace_start - allocation failed");
+		exit(1);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_trace_stop()
+{
+	ctx_switch_lock mutex{};
+	g_mgr.trace.stop();
+	return STATUS_SUCCESS;
+}
+
+int uthread_trace_export(const char* path)
+{
+	std::string json;
+	try
+	{
+		std::vector<trace_event> events;
+		uint64_t dropped = 0;
+		uint64_t end_tsc = 0;
+		{
+			ctx_switch_lock mutex{};
+			events = g_mgr.trace.events();
+			dropped = g_mgr.trace.dropped();
+			end_tsc = read_tsc();
+		}
+
+		// Formatting and writing without the lock, so the other carriers keep switching meanwhile
+		json = format_chrome_trace(events, dropped, end_tsc, g_mgr.clock);
+	}
+	catch (const std::bad_alloc&)
+	{
+		print_system_error("trace_export - allocation failed");
+		exit(1);
+	}
+
+	const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (-1 == fd)
+	{
+		return STATUS_FAILURE;
+	}
+
+	size_t written = 0;
+	while (written < json.size())
+	{
+		const ssize_t result = write(fd, json.data() + written, json.size() - written);
+		if (-1 == result)
+		{
+			if (EINTR == errno)
+			{
+				continue;
+			}
+
+			const int saved_errno = errno;
+			(void)close(fd);
+			errno = saved_errno;
+			return STATUS_FAILURE;
+		}
+		written += static_cast<size_t>(result);
+	}
+
+	if (0 != close(fd))
+	{
+		return STATUS_FAILURE;
+	}
+	return STATUS_SUCCESS;
+}
+
+uthread_mutex* uthread_mutex_create()
+{
+	// Allocating in library code, so the thread isn't switched out within the allocator
+	library_section section{};
+
+	try
+	{
+		return new uthread_mutex();
+	}
+	catch (const std::bad_alloc&)
+	{
+		print_system_error("mutex_create - allocation failed");
+		exit(1);
+	}
+}
+
+int uthread_mutex_destroy(uthread_mutex* mutex)
+{
+	library_section section{};
+
+	if (nullptr == mutex)
+	{
+		print_library_error("mutex_destroy - invalid mutex");
+		return STATUS_FAILURE;
+	}
+
+	// The mutex's lock is released before it is deleted along with it
+	mutex->lock.lock();
+	const bool in_use = (nullptr != mutex->owner()) || !mutex->waiters.empty();
+	mutex->lock.unlock();
+	if (in_use)
+	{
+		print_library_error("mutex_destroy - mutex is in use");
+		return STATUS_FAILURE;
+	}
+
+	delete mutex;
+	return STATUS_SUCCESS;
+}
+
+int uthread_mutex_lock(uthread_mutex* mutex)
+{
+	if (nullptr == mutex)
+	{
+		print_library_error_unlocked("mutex_lock - invalid mutex");
+		return STATUS_FAILURE;
+	}
+
+	{
+		// The thread mustn't be switched out (or moved to another carrier) while it identifies itself
+		library_section section{};
+		uintptr_t unlocked = 0;
+		if (mutex->state.compare_exchange_strong(unlocked, reinterpret_cast<uintptr_t>(running_thread()),
+												 std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			return STATUS_SUCCESS;
+		}
+	}
+
+	object_lock lock(mutex->lock);
+
+	thread* const self = running_thread();
+	if (self == mutex->owner())
+	{
+		print_library_error("mutex_lock - mutex is already locked by the thread");
+		return STATUS_FAILURE;
+	}
+
+	if (acquire_or_mark_mutex(mutex, self))
+	{
+		return STATUS_SUCCESS;
+	}
+
+	// The mutex is handed to the thread once it is woken up
+	lock.wait(&mutex->waiters);
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_mutex_unlock(uthread_mutex* mutex)
+{
+	if (nullptr == mutex)
+	{
+		print_library_error_unlocked("mutex_unlock - mutex isn't locked by the thread");
+		return STATUS_FAILURE;
+	}
+
+	{
+		// Fails once threads wait on the mutex (or if the thread doesn't hold it), which are handled under its lock
+		library_section section{};
+		uintptr_t locked = reinterpret_cast<uintptr_t>(running_thread());
+		if (mutex->state.compare_exchange_strong(locked, 0, std::memory_order_release, std::memory_order_relaxed))
+		{
+			return STATUS_SUCCESS;
+		}
+	}
+
+	object_lock lock(mutex->lock);
+
+	if (running_thread() != mutex->owner())
+	{
+		print_library_error("mutex_unlock - mutex isn't locked by the thread");
+		return STATUS_FAILURE;
+	}
+
+	release_mutex(mutex);
+
+	return STATUS_SUCCESS;
+}
+
+uthread_cond* uthread_cond_create()
+{
+	library_section section{};
+
+	try
+	{
+		return new uthread_cond();
+	}
+	catch (const std::bad_alloc&)
+	{
+		print_system_error("cond_create - allocation failed");
+		exit(1);
+	}
+}
+
+int uthread_cond_destroy(uthread_cond* cond)
+{
+	library_section section{};
+
+	if (nullptr == cond)
+	{
+		print_library_error("cond_destroy - invalid condition variable");
+		return STATUS_FAILURE;
+	}
+
+	cond->lock.lock();
+	const bool in_use = !cond->waiters.empty();
+	cond->lock.unlock();
+	if (in_use)
+	{
+		print_library_error("cond_destroy - condition variable is in use");
+		return STATUS_FAILURE;
+	}
+
+	delete cond;
+	return STATUS_SUCCESS;
+}
+
+int uthread_cond_wait(uthread_cond* cond, uthread_mutex* mutex)
+{
+	if ((nullptr == cond) || (nullptr == mutex))
+	{
+		print_library_error_unlocked("cond_wait - invalid condition variable or mutex");
+		return STATUS_FAILURE;
+	}
+
+	object_lock lock(cond->lock);
+
+	mutex->lock.lock();
+	if (running_thread() != mutex->owner())
+	{
+		mutex->lock.unlock();
+		print_library_error("cond_wait - mutex isn't locked by the thread");
+		return STATUS_FAILURE;
+	}
+
+	if (!cond->waiters.empty() && (mutex != cond->mutex))
+	{
+		mutex->lock.unlock();
+		print_library_error("cond_wait - condition variable is waited on with another mutex");
+		return STATUS_FAILURE;
+	}
+
+	cond->mutex = mutex;
+	release_mutex(mutex);
+	mutex->lock.unlock();
+
+	// The mutex is handed to the thread once it is woken up, after it is signaled
+	lock.wait(&cond->waiters);
+
+	return STATUS_SUCCESS;
+}
+
+/*
+ * Moves the first thread waiting on the condition variable to wait on the mutex - So the thread
+ * is readied up only once it holds the mutex, rather than contending for it once it runs.
+ * Called with the condition variable's lock held, takes the mutex's lock.
+ */
+static void signal_cond(uthread_cond* cond)
+{
+	uthread_mutex* const mutex = cond->mutex;
+	mutex->lock.lock();
+
+	thread* const waiter = cond->waiters.pop_front();
+	if (acquire_or_mark_mutex(mutex, waiter))
+	{
+		wake_waiter(waiter);
+	}
+	else
+	{
+		mutex->waiters.push_back(waiter);
+		waiter->wait_lock.store(&mutex->lock, std::memory_order_relaxed);
+	}
+
+	mutex->lock.unlock();
+}
+
+int uthread_cond_signal(uthread_cond* cond)
+{
+	if (nullptr == cond)
+	{
+		print_library_error_unlocked("cond_signal - invalid condition variable");
+		return STATUS_FAILURE;
+	}
+
+	object_lock lock(cond->lock);
+
+	if (!cond->waiters.empty())
+	{
+		signal_cond(cond);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_cond_broadcast(uthread_cond* cond)
+{
+	if (nullptr == cond)
+	{
+		print_library_error_unlocked("cond_broadcast - invalid condition variable");
+		return STATUS_FAILURE;
+	}
+
+	object_lock lock(cond->lock);
+
+	while (!cond->waiters.empty())
+	{
+		signal_cond(cond);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+uthread_channel* uthread_channel_create(int capacity)
+{
+	library_section section{};
+
+	if (capacity < 0)
+	{
+		print_library_error("channel_create - invalid capacity");
+		return nullptr;
+	}
+
+	try
+	{
+		return new uthread_channel(capacity);
+	}
+	catch (const std::bad_alloc&)
+	{
+		print_system_error("channel_create - allocation failed");
+		exit(1);
+	}
+}
+
+int uthread_channel_destroy(uthread_channel* channel)
+{
+	library_section section{};
+
+	if (nullptr == channel)
+	{
+		print_library_error("channel_destroy - invalid channel");
+		return STATUS_FAILURE;
+	}
+
+	channel->lock.lock();
+	const bool in_use = !channel->senders.empty() || !channel->receivers.empty();
+	channel->lock.unlock();
+	if (in_use)
+	{
+		print_library_error("channel_destroy - channel is in use");
+		return STATUS_FAILURE;
+	}
+
+	delete channel;
+	return STATUS_SUCCESS;
+}
+
+int uthread_channel_send(uthread_channel* channel, void* item)
+{
+	if (nullptr == channel)
+	{
+		print_library_error_unlocked("channel_send - invalid channel");
+		return STATUS_FAILURE;
+	}
+
+	object_lock lock(channel->lock);
+
+	// Handing the item directly to a waiting receiver, the buffer is empty if there is one
+	if (!channel->receivers.empty())
+	{
+		thread* const receiver = channel->receivers.pop_front();
+		receiver->wait_item = item;
+		wake_waiter(receiver);
+		return STATUS_SUCCESS;
+	}
+
+	if (channel->count < channel->items.size())
+	{
+		channel->items[(channel->head + channel->count) % channel->items.size()] = item;
+		channel->count++;
+		return STATUS_SUCCESS;
+	}
+
+	// The item is taken by a receiver before the thread is woken up
+	running_thread()->wait_item = item;
+	lock.wait(&channel->senders);
+
+	return STATUS_SUCCESS;
+}
+
+int uthread_channel_recv(uthread_channel* channel, void** item)
+{
+	if ((nullptr == channel) || (nullptr == item))
+	{
+		print_library_error_unlocked("channel_recv - invalid channel or item");
+		return STATUS_FAILURE;
+	}
+
+	object_lock lock(channel->lock);
+
+	if (0 != channel->count)
+	{
+		*item = channel->items[channel->head];
+		channel->head = (channel->head + 1) % channel->items.size();
+		channel->count--;
+
+		// Taking the item of the first waiting sender into the room left in the buffer
+		if (!channel->senders.empty())
+		{
+			thread* const sender = channel->senders.pop_front();
+			channel->items[(channel->head + channel->count) % channel->items.size()] = sender->wait_item;
+			channel->count++;
+			wake_waiter(sender);
+		}
+		return STATUS_SUCCESS;
+	}
+
+	// An unbuffered channel, taking the item directly from the first waiting sender
+	if (!channel->senders.empty())
+	{
+		thread* const sender = channel->senders.pop_front();
+		*item = sender->wait_item;
+		wake_waiter(sender);
+		return STATUS_SUCCESS;
+	}
+
+	// The item is handed to the thread before it is woken up
+	thread* const self = running_thread();
+	lock.wait(&channel->receivers);
+	*item = self->wait_item;
+
+	return STATUS_SUCCESS;
+}
+
+/*
+ * Sets the file descriptor to non-blocking mode (if it isn't already), so its operations never block the carrier -
+ * Checked on every operation, as the fd may have been closed (and its number reused) since the last one.
+ */
+static bool set_nonblocking(int fd)
+{
+	const int flags = fcntl(fd, F_GETFL);
+	return (-1 != flags) && ((0 != (flags & O_NONBLOCK)) || (-1 != fcntl(fd, F_SETFL, flags | O_NONBLOCK)));
+}
+
+/* Reads without blocking the carrier - From a socket by MSG_DONTWAIT alone, from other fds in non-blocking mode */
+static ssize_t read_nonblocking(int fd, void* buf, size_t count)
+{
+	const ssize_t result = recv(fd, buf, count, MSG_DONTWAIT);
+	if ((-1 != result) || (ENOTSOCK != errno))
+	{
+		return result;
+	}
+
+	if (!set_nonblocking(fd))
+	{
+		return STATUS_FAILURE;
+	}
+
+	return read(fd, buf, count);
+}
+
+/* Writes without blocking the carrier - To a socket by MSG_DONTWAIT alone, to other fds in non-blocking mode */
+static ssize_t write_nonblocking(int fd, const void* buf, size_t count)
+{
+	const ssize_t result = send(fd, buf, count, MSG_DONTWAIT);
+	if ((-1 != result) || (ENOTSOCK != errno))
+	{
+		return result;
+	}
+
+	if (!set_nonblocking(fd))
+	{
+		return STATUS_FAILURE;
+	}
+
+	return write(fd, buf, count);
+}
+
+/* Whether an operation on a non-blocking file descriptor failed only since it isn't ready */
+static bool should_wait(int error)
+{
+	return (EAGAIN == error) || (EWOULDBLOCK == error) || (EINTR == error);
+}
+
+/*
+ * Blocks the running thread until the file descriptor is ready for the events (EPOLLIN/EPOLLOUT).
+ * Returns the ready events, or -1 (with errno set) if the file descriptor can't be waited on. A file
+ * descriptor which doesn't support polling (e.g. a regular file) is always ready.
+ */
+static int wait_for_io(int fd, unsigned int events, const char* caller)
+{
+	object_lock lock(g_mgr.io.lock);
+
+	thread* const self = running_thread();
+	self->io_fd = fd;
+	self->io_events = events;
+	const int error = g_mgr.io.add(self);
+	if (EPERM == error)
+	{
+		self->io_fd = -1;
+		return static_cast<int>(events);
+	}
+
+	if (0 != error)
+	{
+		self->io_fd = -1;
+		if (EEXIST == error)
+		{
+			print_library_error(std::string(caller) + " - fd is already waited on by another thread for the same events");
+		}
+		errno = error;
+		return STATUS_FAILURE;
+	}
+
+	// The ready events are stored in io_events before the thread is woken up - Meanwhile the carrier polls for them,
+	// either as it idles or on each quantum (its timer is kept running while threads wait, see needs_ticks)
+	lock.wait();
+
+	return static_cast<int>(self->io_events);
+}
+
+ssize_t uthread_read(int fd, void* buf, size_t count)
+{
+	while (true)
+	{
+		const ssize_t result = read_nonblocking(fd, buf, count);
+		if ((-1 != result) || !should_wait(errno))
+		{
+			return result;
+		}
+
+		if (STATUS_FAILURE == wait_for_io(fd, EPOLLIN, "read"))
+		{
+			return STATUS_FAILURE;
+		}
+	}
+}
+
+ssize_t uthread_write(int fd, const void* buf, size_t count)
+{
+	while (true)
+	{
+		const ssize_t result = write_nonblocking(fd, buf, count);
+		if ((-1 != result) || !should_wait(errno))
+		{
+			return result;
+		}
+
+		if (STATUS_FAILURE == wait_for_io(fd, EPOLLOUT, "write"))
+		{
+			return STATUS_FAILURE;
+		}
+	}
+}
+
+int uthread_accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen)
+{
+	if (!set_nonblocking(sockfd))
+	{
+		return STATUS_FAILURE;
+	}
+
+	while (true)
+	{
+		const int result = accept(sockfd, addr, addrlen);
+		if ((-1 != result) || !should_wait(errno))
+		{
+			return result;
+		}
+
+		if (STATUS_FAILURE == wait_for_io(sockfd, EPOLLIN, "accept"))
+		{
+			return STATUS_FAILURE;
+		}
+	}
+}
+
+int uthread_poll(int fd, int events)
+{
+	if (0 == (events & (UTHREAD_POLLIN | UTHREAD_POLLOUT)))
+	{
+		print_library_error_unlocked("poll - invalid events");
+		return STATUS_FAILURE;
+	}
+
+	const int ready = wait_for_io(fd, static_cast<unsigned int>(events & (UTHREAD_POLLIN | UTHREAD_POLLOUT)), "poll");
+	if (STATUS_FAILURE == ready)
+	{
+		return STATUS_FAILURE;
+	}
+
+	// Errors and hang-ups are reported as both readable and writable, so the following operation reports them
+	int result = ready & (UTHREAD_POLLIN | UTHREAD_POLLOUT);
+	if (0 != (ready & (EPOLLERR | EPOLLHUP)))
+	{
+		result |= events & (UTHREAD_POLLIN | UTHREAD_POLLOUT);
+	}
+	return result;
 }
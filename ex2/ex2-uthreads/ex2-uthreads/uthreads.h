@@ -7,11 +7,39 @@
 #ifndef _UTHREADS_H
 #define _UTHREADS_H
 
+#include <sys/socket.h>
+#include <sys/types.h>
 
-#define MAX_THREAD_NUM 100 /* maximal number of threads */
-#define STACK_SIZE 4096 /* stack size per thread (in bytes) */
+#define STACK_SIZE (256 * 1024) /* default stack size per thread (in bytes), only the used pages take memory */
+#define PRIORITY_LEVELS 4 /* number of priority levels, 0 being the highest */
+#define DEFAULT_WEIGHT 1024 /* weight of a thread under UTHREAD_SCHED_CFS until it is set, see uthread_set_weight */
+#define UTHREAD_POLLIN 0x001 /* uthread_poll event, the fd is readable (same as POLLIN) */
+#define UTHREAD_POLLOUT 0x004 /* uthread_poll event, the fd is writable (same as POLLOUT) */
+#define UTHREAD_TIMER_TICKLESS 0x1 /* uthread_set_timer flag, the timer ticks only while threads compete for a carrier */
 
 typedef void (*thread_entry_point)(void);
+typedef void* (*thread_entry_point_arg)(void* arg); /* entry point of a joinable thread, see uthread_spawn_arg */
+
+/* Scheduling policies of the library */
+typedef enum
+{
+	UTHREAD_SCHED_RR, /* Round-Robin, a single quantum per thread in a FIFO order */
+	UTHREAD_SCHED_MLFQ, /* Multilevel Feedback Queue, by the threads' priorities and CPU usage */
+	UTHREAD_SCHED_CFS /* Fair-share, by the time each thread has run for relative to its weight */
+} uthread_sched_policy;
+
+/* Timers measuring the quantums, see uthread_set_timer */
+typedef enum
+{
+	UTHREAD_TIMER_VIRTUAL, /* The process' virtual time, or each carrier's CPU time with several carriers (default) */
+	UTHREAD_TIMER_THREAD_CPU, /* Each carrier's CPU time, including the time spent in system calls */
+	UTHREAD_TIMER_MONOTONIC /* Real time, by a high-resolution timer */
+} uthread_timer;
+
+/* Synchronization primitives, see uthread_mutex_create, uthread_cond_create and uthread_channel_create */
+typedef struct uthread_mutex uthread_mutex;
+typedef struct uthread_cond uthread_cond;
+typedef struct uthread_channel uthread_channel;
 
 /* External interface */
 
@@ -30,27 +58,145 @@ typedef void (*thread_entry_point)(void);
 */
 int uthread_init(int quantum_usecs);
 
+/**
+ * @brief initializes the thread library with the given scheduling policy.
+ *
+ * Same as uthread_init (which uses UTHREAD_SCHED_RR), quantum_usecs is the length of the base quantum.
+ * With UTHREAD_SCHED_MLFQ the threads are scheduled by priority level, and each level's quantum is twice as long as
+ * the level above it - A thread which uses up its whole quantum moves a level down, and all the threads are
+ * periodically moved back to the highest level. A ready thread of a higher level than the RUNNING thread preempts it
+ * within a base quantum.
+ * With UTHREAD_SCHED_MLFQ, uthread_get_quantums and uthread_get_total_quantums count the quantums of all lengths.
+ * With any of the policies, the real-time threads (see uthread_set_periodic) run ahead of the threads it schedules.
+ * With UTHREAD_SCHED_CFS the thread which has run for the least time (measured by the timestamp counter, see
+ * uthread_get_runtime_nsecs) divided by its weight runs next, and it is preempted once another READY thread has run
+ * for less - So each thread gets a share of the CPU by its weight, even if it blocks or sleeps in the middle of
+ * quantums. A thread which becomes READY after blocking or sleeping doesn't get to run for the time it has missed,
+ * and a yielding thread runs after all the other READY threads.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_init_sched(int quantum_usecs, uthread_sched_policy policy);
+
+/**
+ * @brief initializes the thread library with the given scheduling policy, running the threads on num_carriers
+ * kernel threads (carriers) in parallel.
+ *
+ * Same as uthread_init_sched (which uses a single carrier). The calling thread is the first carrier, and the others
+ * are created by this function. Each carrier runs its own READY threads, and once it has none it takes READY threads
+ * of the other carriers. Each carrier is preempted every quantum_usecs of its own CPU time (rather than the process'
+ * virtual time, see uthread_set_timer for other timers), and the quantums of all the carriers are counted by
+ * uthread_get_total_quantums.
+ * Blocking or terminating a thread which is RUNNING on another carrier takes effect once that carrier is signaled,
+ * shortly after the function returns.
+ * It is an error to call this function with a non-positive num_carriers.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_init_carriers(int quantum_usecs, uthread_sched_policy policy, int num_carriers);
+
+/**
+ * @brief Selects the timer the quantums are measured by, for the library once it is initialized (by uthread_init or
+ * any of its variants).
+ *
+ * The CPU time timers expire only on the kernel's scheduler ticks (every few milliseconds), so shorter quantums are
+ * stretched to a tick. UTHREAD_TIMER_MONOTONIC measures the quantums in real time to the microsecond, so quantums of
+ * tens of microseconds are kept - Including the time the kernel doesn't run the carrier, or the carrier waits in a
+ * system call.
+ * With the UTHREAD_TIMER_TICKLESS flag, the timer of a carrier is stopped while the thread it runs has no other READY
+ * thread to give way to, and no thread sleeps or waits for a file descriptor - So a thread running alone isn't
+ * interrupted every quantum - Its quantum ends a whole quantum after another thread becomes READY.
+ * It is an error to call this function once the library is initialized, or with an unknown timer or flag.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_timer(uthread_timer timer, int flags);
+
+/**
+ * @brief Selects whether the stacks of the threads have guard pages (they do by default), for the library once it is
+ * initialized (by uthread_init or any of its variants).
+ *
+ * A stack with a guard page is a memory mapping of its own, split in two by the guard page - The kernel limits the
+ * mappings of a process (by vm.max_map_count, 65530 by default), which limits the threads to about 32k. Without guard
+ * pages the stacks share mappings, so hundreds of thousands of threads can be spawned - But a thread overflowing its
+ * stack corrupts the stack below it, rather than crashing the process.
+ * It is an error to call this function once the library is initialized.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_stack_guard(int enabled);
+
 /**
  * @brief Creates a new thread, whose entry point is the function entry_point with the signature
  * void entry_point(void).
  *
  * The thread is added to the end of the READY threads list.
- * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
- * limit (MAX_THREAD_NUM).
- * Each thread should be allocated with a stack of size STACK_SIZE bytes.
- * It is an error to call this function with a null entry_point.
+ * There is no limit on the number of concurrent threads, the ID of a terminated thread may be reused by a
+ * later thread.
+ * Each thread is allocated with a stack of size STACK_SIZE bytes, with a guard page below it (unless disabled by
+ * uthread_set_stack_guard) - Overflowing the stack crashes the process with SIGSEGV. The stacks of terminated threads
+ * are reused by later threads. It is an error to call this function with a null entry_point, or once no more stacks
+ * can be mapped.
  *
  * @return On success, return the ID of the created thread. On failure, return -1.
 */
 int uthread_spawn(thread_entry_point entry_point);
 
+/**
+ * @brief Creates a new thread like uthread_spawn, with a priority hint in the range [0, PRIORITY_LEVELS),
+ * 0 being the highest (which is the priority of threads created with uthread_spawn).
+ *
+ * The priority is only used by the UTHREAD_SCHED_MLFQ policy, as the level the thread starts at.
+ * It is an error to call this function with a priority out of the range.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_prio(thread_entry_point entry_point, int priority);
+
+/**
+ * @brief Creates a new thread like uthread_spawn_prio, with a stack of stack_size bytes instead of STACK_SIZE.
+ *
+ * The stack is reserved in whole, but only the pages the thread touches take memory, so large stacks are cheap.
+ * It is an error to call this function with a non-positive stack_size.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_stack(thread_entry_point entry_point, int priority, int stack_size);
+
+/**
+ * @brief Creates a new joinable thread like uthread_spawn, whose entry point is the function entry_point with the
+ * signature void* entry_point(void* arg), called with arg.
+ *
+ * The value entry_point returns is the result of the thread, taken by uthread_join. Once the thread terminates it
+ * is kept (as a zombie, with its ID) until it is joined - So each joinable thread should be joined, or terminated
+ * again by uthread_terminate to discard its result. A thread terminated by uthread_terminate has a NULL result.
+ * It is an error to call this function with a null entry_point.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_arg(thread_entry_point_arg entry_point, void* arg);
+
+
+/**
+ * @brief Sets the weight of the thread with ID tid, its share of the CPU under UTHREAD_SCHED_CFS (threads have a
+ * weight of DEFAULT_WEIGHT until it is set). A thread with twice the weight of another runs for twice as long.
+ *
+ * The weight applies to the time the thread runs from now on. The other policies ignore the weight.
+ * If no thread with ID tid exists, or weight is non-positive, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_weight(int tid, int weight);
+
 
 /**
  * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
  *
  * All the resources allocated by the library for this thread should be released. If no thread with ID tid exists it
  * is considered an error. Terminating the main thread (tid == 0) will result in the termination of the entire
- * process using exit(0) (after releasing the assigned library memory).
+ * process using exit(0) (after releasing the assigned library memory). The threads joining the thread are woken up
+ * with a NULL result, and terminating a joinable thread which has already terminated (see uthread_spawn_arg)
+ * releases it without being joined.
  *
  * @return The function returns 0 if the thread was successfully terminated and -1 otherwise. If a thread terminates
  * itself or the main thread is terminated, the function does not return.
@@ -58,6 +204,20 @@ int uthread_spawn(thread_entry_point entry_point);
 int uthread_terminate(int tid);
 
 
+/**
+ * @brief Waits (BLOCKED) until the joinable thread with ID tid terminates, and stores its result in *result
+ * (unless result is NULL).
+ *
+ * Several threads may wait for the same thread, and all of them receive its result - Then the thread is
+ * released, along with its ID. Joining a thread which has already terminated returns right away, releasing it.
+ * If no thread with ID tid exists, if it wasn't spawned by uthread_spawn_arg or if it is the calling thread,
+ * it is considered an error.
+ *
+ * @return On success, return 0 (once the thread has terminated). On failure, return -1.
+*/
+int uthread_join(int tid, void** result);
+
+
 /**
  * @brief Blocks the thread with ID tid. The thread may be resumed later using uthread_resume.
  *
@@ -89,14 +249,96 @@ int uthread_resume(int tid);
  * If the thread which was just RUNNING should also be added to the READY queue, or if multiple threads wake up 
  * at the same time, the order in which they're added to the end of the READY queue doesn't matter.
  * The number of quantums refers to the number of times a new quantum starts, regardless of the reason. Specifically,
- * the quantum of the thread which has made the call to uthread_sleep isn’t counted.
- * It is considered an error if the main thread (tid == 0) calls this function.
+ * the quantum of the thread which has made the call to uthread_sleep isn’t counted. While no thread is READY or
+ * RUNNING, the library waits without using the CPU, and a quantum starts every quantum_usecs of real time.
+ * It is considered an error if the main thread (tid == 0) calls this function, or to call it with a non-positive
+ * num_quantums.
  *
  * @return On success, return 0. On failure, return -1.
 */
 int uthread_sleep(int num_quantums);
 
 
+/**
+ * @brief Blocks the RUNNING thread for usecs microseconds of real time, rather than for a number of quantums.
+ *
+ * Same as uthread_sleep, a scheduling decision is made right away. The thread is woken up on the first quantum which
+ * starts after the time has passed, or right away if no thread is RUNNING then. Unlike uthread_sleep, the main
+ * thread may sleep as well. It is an error to call this function with a non-positive usecs.
+ *
+ * @return On success, return 0 (once the thread runs again). On failure, return -1.
+*/
+int uthread_sleep_usecs(int usecs);
+
+
+/**
+ * @brief Makes the thread with ID tid a real-time thread, running a job every period_usecs microseconds (of real
+ * time) for up to budget_usecs microseconds of it. A period_usecs of 0 makes it a normal thread again.
+ *
+ * The real-time threads run ahead of all the other threads, by Earliest Deadline First - The job of each period
+ * should be done by the end of the period, its deadline, which is when the thread calls uthread_wait_next_period.
+ * The first job starts right away. A job which has run for its whole budget is throttled: the thread runs as a
+ * normal thread until its next period. A READY real-time thread preempts a normal thread, or a real-time thread
+ * of a later deadline, within a base quantum - So the quantum should be shorter than the periods (and measured
+ * in real time, see uthread_set_timer).
+ * The thread is admitted only if the real-time threads take up to 95% of a single carrier in total (the sum of
+ * their budgets divided by their periods), so that by EDF their jobs can be done by their deadlines.
+ * If no thread with ID tid exists, if budget_usecs is non-positive or longer than period_usecs, or if there isn't
+ * enough time left for the thread, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_periodic(int tid, int period_usecs, int budget_usecs);
+
+
+/**
+ * @brief Ends the job of the current period of the RUNNING real-time thread, and waits (BLOCKED) until the next
+ * period starts.
+ *
+ * Same as uthread_sleep_usecs, the thread is woken up on the first quantum which starts after its next period
+ * starts. If the job is done after its deadline, the deadline is counted as missed (see
+ * uthread_get_deadline_misses), as are the deadlines of the periods which have passed since, and the job of the
+ * current period starts right away. It is an error to call this function from a thread which isn't periodic.
+ *
+ * @return On success, return 0 (once the next job starts). On failure, return -1.
+*/
+int uthread_wait_next_period();
+
+
+/**
+ * @brief Returns the number of deadlines the real-time thread with ID tid has missed since it was made periodic.
+ *
+ * A deadline is counted once the job is done (see uthread_wait_next_period). If no thread with ID tid exists it is
+ * considered an error.
+ *
+ * @return On success, return the number of missed deadlines. On failure, return -1.
+*/
+int uthread_get_deadline_misses(int tid);
+
+
+/**
+ * @brief Gives up the rest of the quantum of the RUNNING thread.
+ *
+ * The RUNNING thread is moved to the end of the READY queue and a scheduling decision is made, so the thread keeps
+ * running (on a new quantum) only if no other thread is READY. A new quantum starts, exactly as on preemption.
+ *
+ * @return On success, return 0 (once the thread runs again). On failure, return -1.
+*/
+int uthread_yield();
+
+
+/**
+ * @brief Hands the CPU directly to the READY thread with ID tid, bypassing the order of the READY queue.
+ *
+ * The RUNNING thread is moved to the end of the READY queue, and the thread with ID tid starts a new quantum.
+ * Switching to the RUNNING thread itself has no effect. If no thread with ID tid exists, or if it isn't READY
+ * (e.g. blocked or sleeping), it is considered an error.
+ *
+ * @return On success, return 0 (once the calling thread runs again). On failure, return -1.
+*/
+int uthread_switch_to(int tid);
+
+
 /**
  * @brief Returns the thread ID of the calling thread.
  *
@@ -128,4 +370,231 @@ int uthread_get_total_quantums();
 int uthread_get_quantums(int tid);
 
 
+/**
+ * @brief Returns the time the thread with ID tid was in RUNNING state, in nanoseconds.
+ *
+ * Unlike uthread_get_quantums, the time is measured (by the timestamp counter of the CPU) from the moment the thread
+ * is switched to until it is switched out, so quantums cut short by yielding, blocking or sleeping count only for the
+ * time they ran. If the thread is in RUNNING state, the time of the current quantum so far is included. The time is
+ * real time, including any time the kernel didn't run the carrier running the thread.
+ * If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the run time of the thread with ID tid. On failure, return -1.
+*/
+long long uthread_get_runtime_nsecs(int tid);
+
+
+/**
+ * @brief Starts tracing the context switches, recording the last capacity switches (at least) of all the carriers.
+ *
+ * Each switch is recorded with the thread switched from and to, the reason (preempted, yielded, blocked, sleeping,
+ * waiting, terminated, or idle for a carrier which had no thread to run) and a timestamp. Calling this function while
+ * tracing discards the recorded switches. It is an error to call this function with non-positive capacity.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_trace_start(int capacity);
+
+
+/**
+ * @brief Stops tracing the context switches, the recorded switches are kept until tracing is started again.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_trace_stop();
+
+
+/**
+ * @brief Writes the recorded context switches to the file at path, in the Chrome trace event format (JSON, as
+ * viewed in chrome://tracing or Perfetto).
+ *
+ * Each carrier is a track, showing the slices of time each thread ran for and the reason it was switched out.
+ * The trace may be written while still tracing, with the switches recorded so far.
+ *
+ * @return On success, return 0. On failure, return -1 with errno set.
+*/
+int uthread_trace_export(const char* path);
+
+
+
+/**
+ * @brief Creates an unlocked mutex.
+ *
+ * Threads waiting to lock the mutex are BLOCKED until it is unlocked, and then it is handed to them in the order
+ * they have started waiting - Even to a thread which was blocked (by uthread_block) while waiting, which holds it
+ * until it is resumed. A thread should not terminate while holding a mutex, the mutex stays locked.
+ *
+ * @return The created mutex.
+*/
+uthread_mutex* uthread_mutex_create();
+
+
+/**
+ * @brief Destroys the mutex.
+ *
+ * It is an error to destroy a locked mutex, or a mutex threads wait on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_destroy(uthread_mutex* mutex);
+
+
+/**
+ * @brief Locks the mutex, waiting (BLOCKED) until it is unlocked if it is locked by another thread.
+ *
+ * It is an error for a thread to lock a mutex it has already locked.
+ *
+ * @return On success, return 0 (once the mutex is locked by the calling thread). On failure, return -1.
+*/
+int uthread_mutex_lock(uthread_mutex* mutex);
+
+
+/**
+ * @brief Unlocks the mutex, handing it to the first thread waiting on it (if any).
+ *
+ * It is an error to unlock a mutex which isn't locked by the calling thread.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_unlock(uthread_mutex* mutex);
+
+
+/**
+ * @brief Creates a condition variable.
+ *
+ * @return The created condition variable.
+*/
+uthread_cond* uthread_cond_create();
+
+
+/**
+ * @brief Destroys the condition variable.
+ *
+ * It is an error to destroy a condition variable threads wait on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_destroy(uthread_cond* cond);
+
+
+/**
+ * @brief Unlocks the mutex and waits (BLOCKED) on the condition variable until it is signaled, then locks the mutex
+ * again before returning.
+ *
+ * It is an error to wait with a mutex which isn't locked by the calling thread, or with a mutex other than the one
+ * other threads are waiting on the condition variable with.
+ *
+ * @return On success, return 0 (once the mutex is locked by the calling thread). On failure, return -1.
+*/
+int uthread_cond_wait(uthread_cond* cond, uthread_mutex* mutex);
+
+
+/**
+ * @brief Wakes up the first thread waiting on the condition variable (if any).
+ *
+ * The woken thread moves to wait on the mutex, so it isn't READY before the mutex is unlocked.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_signal(uthread_cond* cond);
+
+
+/**
+ * @brief Wakes up all the threads waiting on the condition variable, in the order they have started waiting.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_broadcast(uthread_cond* cond);
+
+
+/**
+ * @brief Creates a channel passing items between threads, buffering up to capacity items.
+ *
+ * With a capacity of 0, each send waits for a receive to take its item.
+ * It is an error to call this function with a negative capacity.
+ *
+ * @return On success, return the created channel. On failure, return NULL.
+*/
+uthread_channel* uthread_channel_create(int capacity);
+
+
+/**
+ * @brief Destroys the channel, the items left in its buffer are discarded.
+ *
+ * It is an error to destroy a channel threads wait on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_channel_destroy(uthread_channel* channel);
+
+
+/**
+ * @brief Sends the item on the channel, waiting (BLOCKED) while the buffer of the channel is full.
+ *
+ * An item sent while threads wait to receive is handed directly to the first of them.
+ *
+ * @return On success, return 0 (once the item is in the buffer or received). On failure, return -1.
+*/
+int uthread_channel_send(uthread_channel* channel, void* item);
+
+
+/**
+ * @brief Receives an item from the channel into *item, waiting (BLOCKED) while the channel is empty.
+ *
+ * Items are received in the order they were sent.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_channel_recv(uthread_channel* channel, void** item);
+
+
+
+/**
+ * @brief Reads from the file descriptor like read(2), blocking only the calling thread until data is available.
+ *
+ * A socket is read with MSG_DONTWAIT, any other file descriptor is set to non-blocking mode. While it has nothing to
+ * read, the thread is BLOCKED (other threads keep running) until the file descriptor becomes readable - It is polled
+ * on each quantum, or waited for by a carrier which has no READY thread. A file descriptor may be waited on by
+ * a single reader and a single writer at a time, it is an error to wait to read from a file descriptor another
+ * thread waits to read from (and so for writing). The file descriptor must not be closed while a thread waits on it.
+ *
+ * @return As read(2), on failure return -1 with errno set.
+*/
+ssize_t uthread_read(int fd, void* buf, size_t count);
+
+
+/**
+ * @brief Writes to the file descriptor like write(2), blocking only the calling thread until there is room to write.
+ *
+ * Same as uthread_read, the thread waits for the file descriptor to become writable.
+ *
+ * @return As write(2), on failure return -1 with errno set.
+*/
+ssize_t uthread_write(int fd, const void* buf, size_t count);
+
+
+/**
+ * @brief Accepts a connection on the socket like accept(2), blocking only the calling thread until there is one.
+ *
+ * Same as uthread_read, the thread waits for the socket to become readable.
+ *
+ * @return As accept(2), on failure return -1 with errno set.
+*/
+int uthread_accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen);
+
+
+/**
+ * @brief Blocks the calling thread until the file descriptor is ready for any of the events, a combination of
+ * UTHREAD_POLLIN and UTHREAD_POLLOUT.
+ *
+ * Same as uthread_read, the thread waits for the file descriptor (which isn't set to non-blocking mode). Errors and
+ * hang-ups of the file descriptor are reported as all of the requested events. It is an error to call this function
+ * without any of the events.
+ *
+ * @return On success, return the ready events. On failure, return -1 (with errno set if the file descriptor can't
+ * be polled).
+*/
+int uthread_poll(int fd, int events);
+
+
 #endif
@@ -56,3 +56,24 @@ void Barrier::barrier()
 		Common::emit_system_error("pthread_mutex_unlock failed");
 	}
 }
+
+void Barrier::arrive()
+{
+	if (0 != pthread_mutex_lock(&mutex))
+	{
+		Common::emit_system_error("pthread_mutex_lock failed");
+	}
+
+	if (++count >= numThreads)
+	{
+		count = 0;
+		if (0 != pthread_cond_broadcast(&cv))
+		{
+			Common::emit_system_error("pthread_cond_broadcast failed");
+		}
+	}
+	if (0 != pthread_mutex_unlock(&mutex))
+	{
+		Common::emit_system_error("pthread_mutex_unlock failed");
+	}
+}
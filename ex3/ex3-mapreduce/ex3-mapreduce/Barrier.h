@@ -11,6 +11,10 @@ public:
 
 	void barrier();
 
+	// Counting an arrival at the barrier on behalf of another thread,
+	// without waiting for the rest of the threads
+	void arrive();
+
 private:
 	pthread_mutex_t mutex;
 	pthread_cond_t cv;
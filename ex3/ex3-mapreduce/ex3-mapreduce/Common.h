@@ -8,6 +8,11 @@
 
 namespace Common
 {
+	// Counters written frequently by different threads are kept on separate cache lines.
+	// These are separated by padding, since over-aligned types can't be allocated with new
+	// before C++17
+	constexpr size_t cache_line_size = 64;
+
 	class system_error : public std::exception
 	{};
 
@@ -27,13 +32,6 @@ namespace Common
 		return !key_less_than(p1, p2) && !key_less_than(p2, p1);
 	}
 
-	inline uint32_t get_stage_processed(uint64_t state)
-	{
-		// The processed count is stored in the 31 least significant bits of the counter
-		// (after the total count)
-		return (state << 33) >> 33;
-	}
-
 	inline uint32_t get_stage_total(uint64_t state)
 	{
 		// The total count is stored in the 31 "middle" bits of the counter
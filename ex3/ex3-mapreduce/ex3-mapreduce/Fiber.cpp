@@ -0,0 +1,80 @@
+#include <cstdint>
+
+#include "Common.h"
+#include "Fiber.h"
+
+Fiber::Fiber(FiberEntrypoint entrypoint, void* args, size_t stack_size) :
+	m_context(),
+	m_caller_context(),
+	m_stack(new char[stack_size]),
+	m_entrypoint(entrypoint),
+	m_ep_args(args),
+	m_done(false),
+	m_exception()
+{
+	if (0 != getcontext(&m_context))
+	{
+		Common::emit_system_error("getcontext failed");
+	}
+
+	m_context.uc_stack.ss_sp = m_stack.get();
+	m_context.uc_stack.ss_size = stack_size;
+	// The fiber never returns through uc_link, it always swaps back to its caller
+	m_context.uc_link = nullptr;
+
+	const uint64_t fiber = reinterpret_cast<uintptr_t>(this);
+	makecontext(
+		&m_context,
+		reinterpret_cast<void (*)()>(trampoline),
+		2,
+		static_cast<unsigned int>(fiber >> 32),
+		static_cast<unsigned int>(fiber & UINT32_MAX));
+}
+
+void Fiber::resume()
+{
+	if (m_done)
+	{
+		return;
+	}
+
+	if (0 != swapcontext(&m_caller_context, &m_context))
+	{
+		Common::emit_system_error("swapcontext failed");
+	}
+
+	if (m_exception)
+	{
+		std::exception_ptr exception = m_exception;
+		m_exception = nullptr;
+		std::rethrow_exception(exception);
+	}
+}
+
+void Fiber::yield()
+{
+	if (0 != swapcontext(&m_context, &m_caller_context))
+	{
+		Common::emit_system_error("swapcontext failed");
+	}
+}
+
+void Fiber::trampoline(unsigned int fiber_high, unsigned int fiber_low)
+{
+	Fiber* fiber = reinterpret_cast<Fiber*>(
+		(static_cast<uintptr_t>(fiber_high) << 32) | static_cast<uintptr_t>(fiber_low));
+
+	try
+	{
+		fiber->m_entrypoint(fiber->m_ep_args);
+	}
+	catch (...)
+	{
+		// Exceptions can't unwind past the fiber's stack, passing it to the resumer
+		fiber->m_exception = std::current_exception();
+	}
+
+	fiber->m_done = true;
+	// Never resumed again
+	fiber->yield();
+}
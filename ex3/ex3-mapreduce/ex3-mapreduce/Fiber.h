@@ -0,0 +1,46 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <ucontext.h>
+
+// Entrypoint for a fiber - Receives a ptr to the arguments
+// Allocation and access to the arguments is at the responsibility of the caller
+using FiberEntrypoint = void (*)(void*);
+
+/* A user-level execution context with its own stack, which runs on the thread resuming it
+ * until it yields back or completes. Fibers are cooperative - They're never preempted.
+ * Note - On failure of system calls, an exception is raised */
+class Fiber
+{
+public:
+	Fiber(FiberEntrypoint entrypoint, void* args, size_t stack_size);
+	Fiber(const Fiber&) = delete;
+	Fiber& operator=(const Fiber&) = delete;
+	~Fiber() = default; // The fiber's stack is released, it must not be running!
+
+	// Running the fiber until it yields or completes.
+	// An exception escaping the fiber's entrypoint is rethrown here
+	void resume();
+
+	// Called from within the fiber - Suspending it, and returning from resume
+	void yield();
+
+	bool is_done() const { return m_done; }
+
+private:
+	// Entrypoint of the context, the fiber ptr is passed as two ints (as makecontext requires)
+	static void trampoline(unsigned int fiber_high, unsigned int fiber_low);
+
+	ucontext_t m_context;
+	ucontext_t m_caller_context;
+	std::unique_ptr<char[]> m_stack;
+	FiberEntrypoint m_entrypoint;
+	void* m_ep_args;
+	bool m_done;
+	std::exception_ptr m_exception;
+};
+
+#endif // FIBER_H
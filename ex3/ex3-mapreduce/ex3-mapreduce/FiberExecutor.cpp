@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
+
+#include "Common.h"
+#include "FiberExecutor.h"
+
+// The stack size of each fiber
+static constexpr size_t fiber_stack_size = 128 * 1024;
+static constexpr int64_t nsec_in_sec = 1000 * 1000 * 1000;
+
+static int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FiberExecutor::FiberExecutor(uint32_t fiber_count, FiberEntrypoint entrypoint, void* args) :
+	m_fibers(fiber_count),
+	m_ready(),
+	m_waiting(),
+	m_current(0)
+{
+	for (uint32_t idx = 0; idx < fiber_count; ++idx)
+	{
+		m_fibers[idx].fiber.reset(new Fiber(entrypoint, args, fiber_stack_size));
+		m_fibers[idx].wakeNs = no_deadline;
+		m_fibers[idx].fd = no_fd;
+		m_ready.push_back(idx);
+	}
+}
+
+void FiberExecutor::run()
+{
+	size_t live_fibers = m_fibers.size();
+	while (0 < live_fibers)
+	{
+		while (!m_ready.empty())
+		{
+			m_current = m_ready.front();
+			m_ready.pop_front();
+
+			// Returns once the fiber waits (and is then placed in the waiting list) or completes
+			m_fibers[m_current].fiber->resume();
+			if (m_fibers[m_current].fiber->is_done())
+			{
+				--live_fibers;
+			}
+		}
+
+		if (0 < live_fibers)
+		{
+			wake_waiting();
+		}
+	}
+}
+
+void FiberExecutor::sleep(unsigned int usecs)
+{
+	m_fibers[m_current].wakeNs = now_ns() + static_cast<int64_t>(usecs) * 1000;
+	wait_current();
+}
+
+void FiberExecutor::wait_readable(int fd)
+{
+	// Not suspending at all if the file descriptor is already readable
+	struct pollfd poll_fd = { fd, POLLIN, 0 };
+	if (0 != poll(&poll_fd, 1, 0))
+	{
+		// Either readable, or an error which the read will report
+		return;
+	}
+
+	m_fibers[m_current].fd = fd;
+	wait_current();
+}
+
+void FiberExecutor::wait_current()
+{
+	m_waiting.push_back(m_current);
+	m_fibers[m_current].fiber->yield();
+}
+
+void FiberExecutor::wake_waiting()
+{
+	// Waiting on all the file descriptors at once, until the earliest deadline
+	std::vector<struct pollfd> poll_fds;
+	int64_t deadline_ns = no_deadline;
+	for (const uint32_t idx : m_waiting)
+	{
+		const FiberSlot& slot = m_fibers[idx];
+		if (no_fd != slot.fd)
+		{
+			poll_fds.push_back({ slot.fd, POLLIN, 0 });
+		}
+		deadline_ns = std::min(deadline_ns, slot.wakeNs);
+	}
+
+	struct timespec timeout = { 0, 0 };
+	const int64_t wait_ns = deadline_ns - now_ns();
+	if (0 < wait_ns)
+	{
+		timeout.tv_sec = wait_ns / nsec_in_sec;
+		timeout.tv_nsec = wait_ns % nsec_in_sec;
+	}
+
+	const int status = ppoll(
+		poll_fds.data(),
+		poll_fds.size(),
+		(no_deadline == deadline_ns) ? nullptr : &timeout,
+		nullptr);
+	if ((-1 == status) && (EINTR != errno))
+	{
+		Common::emit_system_error("ppoll failed");
+	}
+
+	// The file descriptors are polled in the order of the waiting fibers
+	const int64_t now = now_ns();
+	size_t poll_idx = 0;
+	std::vector<uint32_t> still_waiting;
+	for (const uint32_t idx : m_waiting)
+	{
+		FiberSlot& slot = m_fibers[idx];
+		bool ready = (slot.wakeNs <= now);
+		if (no_fd != slot.fd)
+		{
+			ready = ready || ((0 < status) && (0 != poll_fds[poll_idx].revents));
+			++poll_idx;
+		}
+
+		if (ready)
+		{
+			slot.wakeNs = no_deadline;
+			slot.fd = no_fd;
+			m_ready.push_back(idx);
+		}
+		else
+		{
+			still_waiting.push_back(idx);
+		}
+	}
+	m_waiting.swap(still_waiting);
+}
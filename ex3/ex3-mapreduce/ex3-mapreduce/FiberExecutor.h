@@ -0,0 +1,60 @@
+#ifndef FIBER_EXECUTOR_H
+#define FIBER_EXECUTOR_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "Fiber.h"
+
+/* Runs multiple fibers on the calling thread, switching between them whenever the running
+ * fiber waits (for time to pass or for a file descriptor to become readable).
+ * When all of the fibers wait, the thread blocks until the earliest of them may continue.
+ * The waiting functions must only be called from within the executor's fibers. */
+class FiberExecutor
+{
+public:
+	FiberExecutor(uint32_t fiber_count, FiberEntrypoint entrypoint, void* args);
+	FiberExecutor(const FiberExecutor&) = delete;
+	FiberExecutor& operator=(const FiberExecutor&) = delete;
+	~FiberExecutor() = default;
+
+	// Running all the fibers until they complete
+	void run();
+
+	// Suspending the running fiber for (at least) the given time
+	void sleep(unsigned int usecs);
+
+	// Suspending the running fiber until the file descriptor is readable
+	void wait_readable(int fd);
+
+private:
+	struct FiberSlot
+	{
+		std::unique_ptr<Fiber> fiber;
+		// The time the fiber may continue at, or no_deadline
+		int64_t wakeNs;
+		// The file descriptor the fiber waits on, or no_fd
+		int fd;
+	};
+
+	// Suspending the running fiber until it is woken up by run
+	void wait_current();
+
+	// Blocking until at least one of the waiting fibers may continue, and readying them
+	void wake_waiting();
+
+	static constexpr int64_t no_deadline = INT64_MAX;
+	static constexpr int no_fd = -1;
+
+	std::vector<FiberSlot> m_fibers;
+	// The fibers which may run, in FIFO order
+	std::deque<uint32_t> m_ready;
+	// The fibers which wait on time or a file descriptor
+	std::vector<uint32_t> m_waiting;
+	// The fiber currently running
+	uint32_t m_current;
+};
+
+#endif // FIBER_EXECUTOR_H
@@ -1,15 +1,44 @@
 #include <cassert>
 #include <memory>
 #include <algorithm>
+#include <chrono>
+#include <unistd.h>
 
 #include "Common.h"
 #include "Job.h"
 
+/* A running map task is considered a straggler once it has been running for
+ * more than this factor times the median map task duration (and at least
+ * the minimal duration below, to avoid speculating on very short tasks) */
+static constexpr int64_t straggler_median_factor = 4;
+static constexpr int64_t straggler_min_duration_ns = 10 * 1000 * 1000;
+// Interval for idle workers to look for stragglers
+static constexpr useconds_t straggler_poll_interval_usecs = 1000;
+/* The median map task duration is taken again once the completed tasks have grown
+ * by this fraction of their number since it was last taken */
+static constexpr uint32_t median_growth_divisor = 8;
+// The value of a duration slot which hasn't been written yet
+static constexpr int64_t no_duration = -1;
+/* A group is split for reduce (if the client allows it) if it has more pairs than the
+ * minimal size below, and more than half of the pairs a worker should get (on an even
+ * distribution of all the pairs). It is split into parts of at least the minimal size */
+static constexpr size_t hot_group_min_size = 1024;
+static constexpr size_t hot_group_min_part_size = 256;
+
+static int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 Job::Job(
 	const InputVec& inputVec, 
 	OutputVec& outputVec, 
 	const MapReduceClient& client,
-	uint32_t worker_count) :
+	uint32_t worker_count,
+	const JobOptions& options,
+	bool retain_intermediates,
+	Job* base_job) :
 
 	m_inputVec(inputVec),
 	m_outputVec(outputVec),
@@ -17,15 +46,70 @@ Job::Job(
 	m_shuffle_barrier(worker_count),
 	m_shuffle_semaphore(0),
 	m_output_mutex(std::make_shared<Mutex>()),
-	m_reduce_mutex(std::make_shared<Mutex>()),
 	m_stage_status(0),
+	m_next_entry(0),
 	m_shuffleAssign(false),
+	m_map_fibers(options.mapFibersPerWorker),
+	// Speculation requires an idle worker to run on, and is not possible without buffering
+	// (which is per worker, so it can't be used when a worker runs multiple map tasks)
+	m_speculate(client.is_map_idempotent() && (1 < worker_count) && (1 >= m_map_fibers)),
+	m_map_task_done(),
+	m_map_task_speculated(),
+	m_map_tasks_completed(0),
+	m_map_durations(),
+	m_median_duration(no_duration),
+	m_median_completions(0),
+	m_median_updating(false),
+	m_speculative_launched(0),
+	m_speculative_won(0),
 	m_workers(),
 	m_workers_context(),
-	m_shuffle_queue()
+	m_shuffle_queue(),
+	m_reduce_tasks(),
+	m_split_groups(),
+	m_hot_keys_split(0),
+	m_sorted_output(options.sortedOutput),
+	m_slot_outputs(),
+	m_output_barrier(worker_count),
+	m_output_assign(false),
+	m_retain(retain_intermediates),
+	m_retained_groups(),
+	m_retained_taken(false)
 {
 	assert(0 < worker_count);
-	assert(!inputVec.empty());
+	// An incremental job may have nothing to add
+	assert(!inputVec.empty() || (nullptr != base_job));
+	assert((nullptr == base_job) || (m_retain && base_job->m_retain));
+
+	if (nullptr != base_job)
+	{
+		// The retained groups are complete only once the base job is done
+		base_job->wait();
+		// A second job from the same base would find no retained groups, and reduce only its own pairs.
+		// This is a misuse by the client (as is a mergeable client without merge), so it isn't left to an assert
+		if (base_job->m_retained_taken.exchange(true))
+		{
+			Common::emit_system_error("the base job is already the base of another incremental job");
+		}
+		m_retained_groups = std::move(base_job->m_shuffle_queue);
+		base_job->m_shuffle_queue.clear();
+	}
+
+	if (m_speculate)
+	{
+		m_map_task_done.reset(new std::atomic<bool>[m_inputVec.size()]);
+		m_map_task_speculated.reset(new std::atomic<bool>[m_inputVec.size()]);
+		for (size_t idx = 0; idx < m_inputVec.size(); ++idx)
+		{
+			m_map_task_done[idx] = false;
+			m_map_task_speculated[idx] = false;
+		}
+		m_map_durations.reset(new std::atomic<int64_t>[m_inputVec.size()]);
+		for (size_t idx = 0; idx < m_inputVec.size(); ++idx)
+		{
+			m_map_durations[idx] = no_duration;
+		}
+	}
 
 	for (uint32_t idx = 0; idx < worker_count; ++idx)
 	{
@@ -33,6 +117,18 @@ Job::Job(
 	}
 }
 
+Job::~Job()
+{
+	// Retained pairs are owned by the framework (see ctor), unless taken over by another job
+	if (m_retain)
+	{
+		for (auto& group : m_shuffle_queue)
+		{
+			discard_pairs(group);
+		}
+	}
+}
+
 void Job::start_job()
 {
 	assert(UNDEFINED_STAGE == get_stage());
@@ -63,26 +159,62 @@ void Job::get_state(JobState* state) const
 	const uint64_t current_state = m_stage_status.load();
 	state->stage = Common::get_stage(current_state);
 	const uint32_t total_entries = Common::get_stage_total(current_state);
+	if (0 == total_entries)
+	{
+		// Nothing to process on this stage (e.g. an incremental job with no new keys)
+		state->percentage = 100.0f;
+		return;
+	}
+
+	// Each worker counts its own progress on each stage, so there's nothing to reset
+	// between stages, and the sum is only ever behind the actual progress
+	uint32_t processed_entries = 0;
+	for (const auto& worker : m_workers_context)
+	{
+		processed_entries += worker->get_processed(state->stage);
+	}
+
 	state->percentage = 100.0f *
-		// Taking the minimum since the processed data can be "more" while the
-		// threads are validating they're not out of bounds
-		static_cast<float>(std::min(Common::get_stage_processed(current_state), total_entries)) / 
+		static_cast<float>(std::min(processed_entries, total_entries)) / 
 		static_cast<float>(total_entries);
 }
 
+void Job::get_stats(JobStats* stats) const
+{
+	stats->speculativeLaunched = m_speculative_launched.load();
+	stats->speculativeWon = m_speculative_won.load();
+	stats->hotKeysSplit = m_hot_keys_split.load();
+}
+
 void Job::add_output(K3* key, V3* value)
 {
 	AutoMutexLock lock(m_output_mutex);
 	m_outputVec.push_back(std::make_pair(key, value));
 }
 
+void WorkerContext::emit_output(const OutputPair& pair)
+{
+	if (nullptr != outputTarget)
+	{
+		outputTarget->push_back(pair);
+	}
+	else if (jobContext->is_output_sorted())
+	{
+		orderedOutput.emplace_back(currentSlot, pair);
+	}
+	else
+	{
+		jobContext->add_output(pair.first, pair.second);
+	}
+}
+
 void Job::add_worker()
 {
 	// Allowing addition of workers only before the job has started
 	assert(UNDEFINED_STAGE == get_stage());
 
 	// Initialize the worker thread
-	WorkerContextUPtr worker_ctx(new WorkerContext(this));
+	WorkerContextUPtr worker_ctx(new WorkerContext(this, m_speculate));
 	ThreadPtr worker = std::make_shared<Thread>(job_worker_thread, worker_ctx.get());
 
 	m_workers.emplace_back(std::move(worker));
@@ -104,14 +236,14 @@ uint32_t Job::get_stage_total() const
 
 void Job::set_stage(stage_t new_stage, uint32_t total)
 {
+	m_next_entry = 0;
 	m_stage_status = (static_cast<uint64_t>(new_stage) << 62) | 
 					 (static_cast<uint64_t>(total) << 31);
 }
 
-uint32_t Job::inc_stage_processed(uint32_t val)
+uint32_t Job::claim_next_entry()
 {
-	// Increment the processed count
-	return (m_stage_status.fetch_add(val) << 33) >> 33;
+	return m_next_entry.fetch_add(1);
 }
 
 bool Job::assign_shuffle_job()
@@ -126,30 +258,29 @@ void Job::worker_handle_current_stage(WorkerContext* worker_ctx)
 
 	Job* job_context = worker_ctx->jobContext;
 
-	// Incrementing the processed count, and checking if the stage is complete
-	uint32_t old_val = job_context->inc_stage_processed(1);
-	while (old_val < job_context->get_stage_total())
+	// The stage doesn't change while its entries are being processed
+	const stage_t stage = job_context->get_stage();
+	const uint32_t total_entries = job_context->get_stage_total();
+
+	// Claiming the next entry, and checking if the stage is complete
+	uint32_t old_val = job_context->claim_next_entry();
+	while (old_val < total_entries)
 	{
-		switch (job_context->get_stage())
+		switch (stage)
 		{
 		case MAP_STAGE:
+			if (!worker_run_map_task(worker_ctx, old_val))
 			{
-				const InputPair current_entry = job_context->m_inputVec[old_val];
-				job_context->m_client.map(
-					current_entry.first, 
-					current_entry.second,
-					worker_ctx);
+				// The task has been completed by a speculative run, which also took over
+				// the rest of this worker's map stage
+				worker_ctx->takenOver = true;
+				return;
 			}
 			break;
 
 		case REDUCE_STAGE:
-			{
-				job_context->m_reduce_mutex->lock();
-				const IntermediateVec current_entry = job_context->m_shuffle_queue.back();
-				job_context->m_shuffle_queue.pop_back();
-				job_context->m_reduce_mutex->unlock();
-				job_context->m_client.reduce(&current_entry, worker_ctx);
-			}
+			worker_run_reduce_task(worker_ctx, old_val);
+			worker_ctx->add_processed(REDUCE_STAGE, 1);
 			break;
 
 		case SHUFFLE_STAGE:
@@ -158,13 +289,200 @@ void Job::worker_handle_current_stage(WorkerContext* worker_ctx)
 			// This should never happen
 			break;
 		}
-		old_val = job_context->inc_stage_processed(1);
+		old_val = job_context->claim_next_entry();
 	}
 }
 
-void Job::worker_shuffle_stage(Job* job_context)
+void Job::worker_handle_map_fibers(WorkerContext* worker_ctx)
 {
-	assert(nullptr != job_context);
+	FiberExecutor executor(worker_ctx->jobContext->m_map_fibers, map_fiber, worker_ctx);
+	worker_ctx->executor = &executor;
+	executor.run();
+	worker_ctx->executor = nullptr;
+}
+
+void Job::map_fiber(void* context)
+{
+	// The fibers of the worker run on the same thread, one at a time,
+	// so they share the worker's context as is
+	worker_handle_current_stage(static_cast<WorkerContext*>(context));
+}
+
+bool Job::worker_run_map_task(WorkerContext* worker_ctx, int64_t task)
+{
+	Job* job_context = worker_ctx->jobContext;
+	const InputPair& current_entry = job_context->m_inputVec[task];
+
+	if (!job_context->m_speculate)
+	{
+		job_context->m_client.map(
+			current_entry.first,
+			current_entry.second,
+			worker_ctx);
+		worker_ctx->add_processed(MAP_STAGE, 1);
+		return true;
+	}
+
+	const int64_t start_ns = now_ns();
+	worker_ctx->taskStartNs = start_ns;
+	worker_ctx->currentTask = task;
+
+	job_context->m_client.map(
+		current_entry.first,
+		current_entry.second,
+		worker_ctx);
+
+	bool expected = false;
+	if (!job_context->m_map_task_done[task].compare_exchange_strong(expected, true))
+	{
+		// Another run has completed the task first, the pairs of this run are redundant
+		discard_pairs(worker_ctx->pendingVec);
+		worker_ctx->currentTask = WorkerContext::no_task;
+		return false;
+	}
+
+	// Committing the pairs before announcing the task is no longer running,
+	// so a worker taking over this worker would see them
+	worker_ctx->intermediateVec.insert(
+		worker_ctx->intermediateVec.end(),
+		worker_ctx->pendingVec.begin(),
+		worker_ctx->pendingVec.end());
+	worker_ctx->pendingVec.clear();
+	worker_ctx->currentTask = WorkerContext::no_task;
+	// Each completion gets a slot of its own, as each task is completed exactly once
+	const uint32_t slot = job_context->m_map_tasks_completed++;
+	job_context->m_map_durations[slot] = now_ns() - start_ns;
+	// Only the winning run counts the task
+	worker_ctx->add_processed(MAP_STAGE, 1);
+	return true;
+}
+
+int64_t Job::find_straggler(WorkerContext* worker_ctx, int64_t now, WorkerContext** straggler)
+{
+	Job* job_context = worker_ctx->jobContext;
+
+	const int64_t median_ns = map_median_duration(worker_ctx);
+	if (0 > median_ns)
+	{
+		// No baseline to compare against yet
+		return WorkerContext::no_task;
+	}
+	const int64_t threshold_ns =
+		std::max(straggler_median_factor * median_ns, straggler_min_duration_ns);
+
+	for (const auto& other : job_context->m_workers_context)
+	{
+		const int64_t task = other->currentTask.load();
+		if ((other.get() == worker_ctx) ||
+			(WorkerContext::no_task == task) ||
+			job_context->m_map_task_done[task] ||
+			job_context->m_map_task_speculated[task])
+		{
+			continue;
+		}
+
+		// The start time may be of a newer task than the one read above, which
+		// can only make the task look shorter than it is
+		if (threshold_ns < (now - other->taskStartNs.load()))
+		{
+			bool expected = false;
+			if (job_context->m_map_task_speculated[task].compare_exchange_strong(expected, true))
+			{
+				*straggler = other.get();
+				return task;
+			}
+		}
+	}
+
+	return WorkerContext::no_task;
+}
+
+int64_t Job::map_median_duration(WorkerContext* worker_ctx)
+{
+	Job* job_context = worker_ctx->jobContext;
+
+	const uint32_t completions = job_context->m_map_tasks_completed.load();
+	const uint32_t median_completions = job_context->m_median_completions.load();
+	if ((completions <= median_completions + median_completions / median_growth_divisor) ||
+		job_context->m_median_updating.exchange(true))
+	{
+		// Recent enough, or being taken by another worker in the meantime
+		return job_context->m_median_duration.load();
+	}
+
+	// Copying the durations written so far, a completion may have taken its slot
+	// without having written its duration yet
+	std::vector<int64_t> durations;
+	durations.reserve(completions);
+	for (uint32_t slot = 0; slot < completions; ++slot)
+	{
+		const int64_t duration = job_context->m_map_durations[slot].load();
+		if (no_duration != duration)
+		{
+			durations.push_back(duration);
+		}
+	}
+
+	if (!durations.empty())
+	{
+		const auto median = durations.begin() + durations.size() / 2;
+		std::nth_element(durations.begin(), median, durations.end());
+		job_context->m_median_duration = *median;
+		job_context->m_median_completions = static_cast<uint32_t>(durations.size());
+	}
+	job_context->m_median_updating = false;
+	return job_context->m_median_duration.load();
+}
+
+void Job::worker_speculate_stragglers(WorkerContext* worker_ctx)
+{
+	Job* job_context = worker_ctx->jobContext;
+	const uint32_t total_tasks = static_cast<uint32_t>(job_context->m_inputVec.size());
+
+	while (job_context->m_map_tasks_completed < total_tasks)
+	{
+		WorkerContext* straggler = nullptr;
+		const int64_t task = find_straggler(worker_ctx, now_ns(), &straggler);
+		if (WorkerContext::no_task == task)
+		{
+			usleep(straggler_poll_interval_usecs);
+			continue;
+		}
+
+		job_context->m_speculative_launched++;
+		if (worker_run_map_task(worker_ctx, task))
+		{
+			job_context->m_speculative_won++;
+
+			// The straggler has not completed the task, so it is still within its map call,
+			// and will skip the rest of the map stage once it returns - So finishing its part
+			// on its behalf. Since its emits are buffered, its intermediate vector is no
+			// longer touched by it.
+			std::sort(
+				straggler->intermediateVec.begin(),
+				straggler->intermediateVec.end(),
+				Common::key_less_than
+			);
+			job_context->m_shuffle_barrier.arrive();
+		}
+	}
+}
+
+void Job::discard_pairs(IntermediateVec& pairs)
+{
+	for (const auto& pair : pairs)
+	{
+		delete pair.first;
+		delete pair.second;
+	}
+	pairs.clear();
+}
+
+void Job::worker_shuffle_stage(WorkerContext* worker_ctx)
+{
+	assert(nullptr != worker_ctx);
+
+	Job* job_context = worker_ctx->jobContext;
 	
 	IntermediateVec backPairs;
 	uint32_t total_size = 0;
@@ -202,11 +520,11 @@ void Job::worker_shuffle_stage(Job* job_context)
 			}
 		}
 
-		job_context->inc_stage_processed(
-			static_cast<uint32_t>(all_key_pairs.size()));
+		worker_ctx->add_processed(
+			SHUFFLE_STAGE, static_cast<uint32_t>(all_key_pairs.size()));
 
 		// The new intermediate vector is ready
-		job_context->m_shuffle_queue.push_back(all_key_pairs);
+		job_context->m_shuffle_queue.push_back(std::move(all_key_pairs));
 
 		backPairs.clear();
 		for (const auto& worker : job_context->m_workers_context)
@@ -218,6 +536,216 @@ void Job::worker_shuffle_stage(Job* job_context)
 			}
 		}
 	} 
+
+	// The groups were extracted from the maximal key downwards
+	std::reverse(job_context->m_shuffle_queue.begin(), job_context->m_shuffle_queue.end());
+
+	if (job_context->m_retain)
+	{
+		merge_retained_groups(job_context);
+	}
+	else
+	{
+		std::vector<uint32_t> groups(job_context->m_shuffle_queue.size());
+		for (uint32_t idx = 0; idx < groups.size(); ++idx)
+		{
+			groups[idx] = idx;
+		}
+		create_reduce_tasks(job_context, groups);
+	}
+}
+
+void Job::create_reduce_tasks(Job* job_context, const std::vector<uint32_t>& groups)
+{
+	assert(nullptr != job_context);
+
+	const size_t worker_count = job_context->m_workers_context.size();
+	size_t hot_group_size = SIZE_MAX;
+	if (job_context->m_client.is_reduce_mergeable() && (1 < worker_count))
+	{
+		size_t total_size = 0;
+		for (const uint32_t group : groups)
+		{
+			total_size += job_context->m_shuffle_queue[group].size();
+		}
+		hot_group_size = std::max(hot_group_min_size, total_size / worker_count / 2);
+	}
+
+	job_context->m_reduce_tasks.reserve(groups.size());
+	// The tasks are created in the order of the groups, which is the order of the keys
+	for (const uint32_t group : groups)
+	{
+		const uint32_t group_size = static_cast<uint32_t>(job_context->m_shuffle_queue[group].size());
+		if (group_size <= hot_group_size)
+		{
+			job_context->m_reduce_tasks.push_back(
+				{ group, 0, group_size, ReduceTask::not_split, 0 });
+			continue;
+		}
+
+		// A part per worker, unless the parts would be too small
+		const uint32_t part_count = static_cast<uint32_t>(
+			std::min(worker_count, group_size / hot_group_min_part_size));
+		const uint32_t split = static_cast<uint32_t>(job_context->m_split_groups.size());
+		job_context->m_split_groups.emplace_back(new SplitGroup(part_count));
+		job_context->m_hot_keys_split++;
+		for (uint32_t part = 0; part < part_count; ++part)
+		{
+			job_context->m_reduce_tasks.push_back({
+				group,
+				static_cast<uint32_t>(static_cast<uint64_t>(group_size) * part / part_count),
+				static_cast<uint32_t>(static_cast<uint64_t>(group_size) * (part + 1) / part_count),
+				split,
+				part });
+		}
+	}
+
+	if (job_context->m_sorted_output)
+	{
+		job_context->m_slot_outputs.resize(job_context->m_reduce_tasks.size(), 0);
+	}
+}
+
+void Job::worker_run_reduce_task(WorkerContext* worker_ctx, uint32_t task_index)
+{
+	Job* job_context = worker_ctx->jobContext;
+	const ReduceTask& task = job_context->m_reduce_tasks[task_index];
+	// The shuffle queue is not modified during the reduce stage,
+	// so the groups may be accessed in place
+	const IntermediateVec& group = job_context->m_shuffle_queue[task.group];
+	// A split group's outputs are placed on the slot of its first part
+	worker_ctx->currentSlot = task_index - task.part;
+	const size_t outputs_before = worker_ctx->orderedOutput.size();
+
+	if (ReduceTask::not_split == task.split)
+	{
+		job_context->m_client.reduce(&group, worker_ctx);
+	}
+	else
+	{
+		worker_reduce_part(worker_ctx, task);
+	}
+
+	// Only the worker producing the slot's outputs writes the slot's count
+	// (the parts of a split group which do not merge it have nothing to add)
+	const size_t outputs = worker_ctx->orderedOutput.size() - outputs_before;
+	if (0 != outputs)
+	{
+		job_context->m_slot_outputs[worker_ctx->currentSlot] = outputs;
+	}
+}
+
+void Job::worker_reduce_part(WorkerContext* worker_ctx, const ReduceTask& task)
+{
+	Job* job_context = worker_ctx->jobContext;
+	const IntermediateVec& group = job_context->m_shuffle_queue[task.group];
+
+	SplitGroup& split = *job_context->m_split_groups[task.split];
+	const IntermediateVec part(group.begin() + task.begin, group.begin() + task.end);
+	worker_ctx->outputTarget = &split.partials[task.part];
+	job_context->m_client.reduce(&part, worker_ctx);
+	worker_ctx->outputTarget = nullptr;
+
+	// The last part to complete merges all of the parts' outputs (the atomic decrement
+	// orders the other parts' outputs before the merge)
+	if (1 == split.remaining.fetch_sub(1))
+	{
+		OutputVec partials;
+		for (const auto& part_output : split.partials)
+		{
+			partials.insert(partials.end(), part_output.begin(), part_output.end());
+		}
+		job_context->m_client.merge(&partials, worker_ctx);
+	}
+}
+
+void Job::worker_sorted_output_stage(WorkerContext* worker_ctx)
+{
+	Job* job_context = worker_ctx->jobContext;
+
+	// Waiting for all the outputs to be emitted
+	job_context->m_output_barrier.barrier();
+
+	bool val = false;
+	if (job_context->m_output_assign.compare_exchange_strong(val, true))
+	{
+		// Turning the slots' counts into offsets (there are as many slots as reduce tasks,
+		// far less than outputs), and making room for all the outputs
+		size_t offset = job_context->m_outputVec.size();
+		for (auto& slot : job_context->m_slot_outputs)
+		{
+			const size_t count = slot;
+			slot = offset;
+			offset += count;
+		}
+		job_context->m_outputVec.resize(offset);
+	}
+
+	job_context->m_output_barrier.barrier();
+
+	// The outputs of a slot are consecutive in the buffer of the worker which emitted them,
+	// so each worker places its outputs in their final positions independently
+	uint32_t slot = 0;
+	size_t position = 0;
+	bool first = true;
+	for (const auto& output : worker_ctx->orderedOutput)
+	{
+		if (first || (slot != output.first))
+		{
+			slot = output.first;
+			position = job_context->m_slot_outputs[slot];
+			first = false;
+		}
+		job_context->m_outputVec[position++] = output.second;
+	}
+	worker_ctx->orderedOutput.clear();
+}
+
+void Job::merge_retained_groups(Job* job_context)
+{
+	assert(nullptr != job_context);
+
+	std::vector<IntermediateVec>& retained = job_context->m_retained_groups;
+	std::vector<IntermediateVec>& delta = job_context->m_shuffle_queue;
+	std::vector<IntermediateVec> merged;
+	merged.reserve(retained.size() + delta.size());
+	std::vector<uint32_t> changed_groups;
+
+	// Both sequences are sorted by key, and have a single group per key
+	auto retained_it = retained.begin();
+	auto delta_it = delta.begin();
+	while ((retained.end() != retained_it) || (delta.end() != delta_it))
+	{
+		if ((delta.end() == delta_it) ||
+			((retained.end() != retained_it) &&
+			 Common::key_less_than(retained_it->front(), delta_it->front())))
+		{
+			// Unchanged key, not reduced again
+			merged.push_back(std::move(*retained_it));
+			++retained_it;
+			continue;
+		}
+
+		changed_groups.push_back(static_cast<uint32_t>(merged.size()));
+		if ((retained.end() != retained_it) &&
+			Common::key_equals(retained_it->front(), delta_it->front()))
+		{
+			// Existing key with new pairs, reduced with all of its pairs
+			retained_it->insert(retained_it->end(), delta_it->begin(), delta_it->end());
+			merged.push_back(std::move(*retained_it));
+			++retained_it;
+		}
+		else
+		{
+			// A new key
+			merged.push_back(std::move(*delta_it));
+		}
+		++delta_it;
+	}
+
+	job_context->m_retained_groups.clear();
+	job_context->m_shuffle_queue = std::move(merged);
+	create_reduce_tasks(job_context, changed_groups);
 }
 
 void* Job::job_worker_thread(void* context)
@@ -230,27 +758,46 @@ void* Job::job_worker_thread(void* context)
 		Job* job_context = worker_ctx->jobContext;
 
 		/*** MAP STAGE ***/
-		worker_handle_current_stage(worker_ctx);
-		// The map stage has been completed, sort the intermediate vector according to the key
-		std::sort(
-			worker_ctx->intermediateVec.begin(),
-			worker_ctx->intermediateVec.end(),
-			Common::key_less_than
-		);
+		if (1 < job_context->m_map_fibers)
+		{
+			worker_handle_map_fibers(worker_ctx);
+		}
+		else
+		{
+			worker_handle_current_stage(worker_ctx);
+		}
 
-		// Waiting on the barrier for all the workers to complete their map stage
-		job_context->m_shuffle_barrier.barrier();
+		// A worker whose task was won by a speculative run has been taken over,
+		// it only joins the rest of the workers on the reduce stage
+		const bool taken_over = worker_ctx->takenOver;
+		if (!taken_over)
+		{
+			if (job_context->m_speculate)
+			{
+				worker_speculate_stragglers(worker_ctx);
+			}
+
+			// The map stage has been completed, sort the intermediate vector according to the key
+			std::sort(
+				worker_ctx->intermediateVec.begin(),
+				worker_ctx->intermediateVec.end(),
+				Common::key_less_than
+			);
+
+			// Waiting on the barrier for all the workers to complete their map stage
+			job_context->m_shuffle_barrier.barrier();
+		}
 
 		/*** SHUFFLE STAGE - ONE WORKER ONLY ***/
 		// Once done - Starting the shuffle phase on one thread
-		if (job_context->assign_shuffle_job())
+		if (!taken_over && job_context->assign_shuffle_job())
 		{
 			// Shuffle stage is assigned to the current worker
-			worker_shuffle_stage(job_context);
+			worker_shuffle_stage(worker_ctx);
 
 			// Shuffle is complete, allowing the beginning of the reduce stage
 			job_context->set_stage(
-				REDUCE_STAGE, static_cast<uint32_t>(job_context->m_shuffle_queue.size()));
+				REDUCE_STAGE, static_cast<uint32_t>(job_context->m_reduce_tasks.size()));
 		}
 		else // Or waiting for the shuffle to end on the other threads
 		{
@@ -262,6 +809,11 @@ void* Job::job_worker_thread(void* context)
 
 		/*** REDUCE STAGE ***/
 		worker_handle_current_stage(worker_ctx);
+
+		if (job_context->m_sorted_output)
+		{
+			worker_sorted_output_stage(worker_ctx);
+		}
 	}
 	catch (...)
 	{
@@ -2,13 +2,17 @@
 #define JOB_CONTEXT_H
 
 #include <atomic>
+#include <cstdint>
 #include <queue>
+#include <memory>
 
+#include "Common.h"
 #include "MapReduceFramework.h"
 #include "Thread.h"
 #include "Barrier.h"
 #include "Mutex.h"
 #include "CSemaphore.h"
+#include "FiberExecutor.h"
 
 class Job;
 
@@ -19,19 +23,130 @@ class Job;
 class WorkerContext
 {
 public:
-	WorkerContext(Job* job_context) :
+	WorkerContext(Job* job_context, bool buffer_emits) :
 		jobContext(job_context),
-		intermediateVec()
-	{}
+		intermediateVec(),
+		pendingVec(),
+		bufferEmits(buffer_emits),
+		currentTask(no_task),
+		taskStartNs(0),
+		takenOver(false),
+		outputTarget(nullptr),
+		orderedOutput(),
+		currentSlot(0),
+		executor(nullptr),
+		processed()
+	{
+		for (auto& counter : processed)
+		{
+			counter = 0;
+		}
+	}
+
+	// Called by emit2, places the pair according to the emit mode of the worker
+	void emit_intermediate(const IntermediatePair& pair)
+	{
+		if (bufferEmits)
+		{
+			pendingVec.push_back(pair);
+		}
+		else
+		{
+			intermediateVec.push_back(pair);
+		}
+	}
+
+	// Called by emit3, places the pair in the output target if set, or in the job's output
+	void emit_output(const OutputPair& pair);
+
+	// Counting entries processed by the worker on the given stage. Only the worker itself
+	// writes its counters, so a plain store suffices (no locked read-modify-write)
+	void add_processed(stage_t stage, uint32_t val)
+	{
+		processed[stage].store(
+			processed[stage].load(std::memory_order_relaxed) + val,
+			std::memory_order_relaxed);
+	}
+
+	uint32_t get_processed(stage_t stage) const
+	{
+		return processed[stage].load(std::memory_order_relaxed);
+	}
+
+	static constexpr int64_t no_task = -1;
 
 	// Reference to the owning job context
 	Job* jobContext;
 	// The worker's intermediate vector
 	IntermediateVec intermediateVec;
+	// The pairs emitted by the map task currently running on the worker,
+	// used only when emits are buffered (speculative execution is enabled)
+	IntermediateVec pendingVec;
+	// Whether the emitted pairs should go to the pending vector first
+	const bool bufferEmits;
+	// The map task currently running on the worker (or no_task),
+	// and the time it has started at - Read by idle workers looking for stragglers
+	std::atomic<int64_t> currentTask;
+	std::atomic<int64_t> taskStartNs;
+	// Set once a speculative run has won the worker's task, the worker then skips
+	// the rest of the map stage (which was done on its behalf)
+	bool takenOver;
+	// Where the reduce running on the worker outputs to, instead of the job's output
+	// (e.g. the partial results of a part of a split key). Not set by default
+	OutputVec* outputTarget;
+	// The outputs of the worker when the job's output is sorted, each with its slot -
+	// the index of the reduce task it belongs to. A slot's outputs are all emitted by
+	// a single worker (for a split group, the one merging it, on its first part's slot)
+	std::vector<std::pair<uint32_t, OutputPair>> orderedOutput;
+	// The slot of the reduce task currently running on the worker
+	uint32_t currentSlot;
+	// Runs the worker's map tasks as fibers, if enabled for the job (nullptr otherwise)
+	FiberExecutor* executor;
+
+private:
+	// The worker's progress on each stage, summed up by Job::get_state on demand.
+	// Kept on a cache line of their own, as other fields are read by other workers
+	char processedPaddingBefore[Common::cache_line_size];
+	std::atomic<uint32_t> processed[REDUCE_STAGE + 1];
+	char processedPaddingAfter[Common::cache_line_size];
 };
 
 using WorkerContextUPtr = std::unique_ptr<WorkerContext>;
 
+/*
+ * A key whose pairs were split into parts, reduced separately and then merged
+ */
+struct SplitGroup
+{
+	SplitGroup(uint32_t part_count) :
+		partials(part_count),
+		remaining(part_count)
+	{}
+
+	// The outputs of each part, each written only by the worker reducing the part
+	std::vector<OutputVec> partials;
+	// The number of parts not reduced yet, the worker reducing the last part merges
+	std::atomic<uint32_t> remaining;
+};
+
+using SplitGroupUPtr = std::unique_ptr<SplitGroup>;
+
+/*
+ * An entry of the reduce stage - A range of the pairs of one of the shuffled groups
+ * (the whole group, unless split)
+ */
+struct ReduceTask
+{
+	static constexpr uint32_t not_split = UINT32_MAX;
+
+	uint32_t group;
+	uint32_t begin;
+	uint32_t end;
+	// The index of the split group (and of the part within it) if the group was split
+	uint32_t split;
+	uint32_t part;
+};
+
 /*
  * The Job is the workhorse of the MapReduce framework
  * Within this class resides all the logic from end-to-end
@@ -44,17 +159,27 @@ using WorkerContextUPtr = std::unique_ptr<WorkerContext>;
 class Job
 {
 public:
+	/* options - The optional behaviors of the job (see JobOptions)
+	 * retain_intermediates - Whether to keep the grouped intermediate pairs once the job
+	 *						  completes, to be reused by an incremental follow-up job.
+	 *						  The framework owns retained pairs and deletes them with the job.
+	 * base_job - A retaining job whose retained pairs are taken over by this job,
+	 *			  such that only the input given to this job is mapped, and only the keys
+	 *			  which received new pairs are reduced. May be nullptr. */
 	Job(
 		const InputVec& inputVec, 
 		OutputVec& outputVec, 
 		const MapReduceClient& client,
-		uint32_t worker_count);
+		uint32_t worker_count,
+		const JobOptions& options,
+		bool retain_intermediates = false,
+		Job* base_job = nullptr);
 	Job(const Job&) = delete;
 	Job& operator=(const Job&) = delete;
 	// The dtor is not waiting for the worker threads to finish
 	// it is in the responsibility of the caller to wait for the job to finish,
 	// otherwise the threads will be forcefully terminated
-	~Job() = default;
+	~Job();
 
 	// Starting the job, by starting all the worker threads
 	void start_job();
@@ -65,8 +190,14 @@ public:
 	// Retreiving the current state of the job
 	void get_state(JobState* state) const;
 
+	// Retreiving the statistics of the job
+	void get_stats(JobStats* stats) const;
+
 	void add_output(K3* key, V3* value);
 
+	// Whether the outputs are kept by the workers, to be placed in the output in order
+	bool is_output_sorted() const { return m_sorted_output; }
+
 private:
 	// Adding a worker thread
 	void add_worker();
@@ -74,8 +205,11 @@ private:
 	// Stage status utilities
 	stage_t get_stage() const;
 	uint32_t get_stage_total() const;
+	// Moving to a new stage, and resetting the claim counter for its entries.
+	// Must not run concurrently to workers claiming entries
 	void set_stage(stage_t new_stage, uint32_t total);
-	uint32_t inc_stage_processed(uint32_t val);
+	// Claiming the next entry to process on the current stage
+	uint32_t claim_next_entry();
 
 	/* Atomically assigning the shuffle job
 	 * Returns true if the shuffle job has been assigned to the caller,
@@ -87,12 +221,85 @@ private:
 	static void worker_handle_current_stage(
 		WorkerContext* worker_ctx);
 
+	/* -- Worker Utility function --
+	 * Worker's map stage handler when map tasks run as fibers - Running a number of
+	 * fibers, each claiming and running map tasks like a separate worker */
+	static void worker_handle_map_fibers(
+		WorkerContext* worker_ctx);
+
+	/* -- Worker Utility function --
+	 * Entrypoint of a map fiber */
+	static void map_fiber(void* context);
+
+	/* -- Worker Utility function --
+	 * Runs a single map task on the worker. When emits are buffered, the task's pairs
+	 * are kept only if this run is the first to complete the task.
+	 * Returns false if the run lost to another run of the same task */
+	static bool worker_run_map_task(
+		WorkerContext* worker_ctx, int64_t task);
+
+	/* -- Worker Utility function --
+	 * Called by a worker which has no map tasks left to claim. Until all the map tasks
+	 * are complete, re-executes tasks running far longer than the median map task.
+	 * Winning a task on behalf of a straggler also takes over the straggler's
+	 * part in the map stage (sorting and arriving at the shuffle barrier) */
+	static void worker_speculate_stragglers(
+		WorkerContext* worker_ctx);
+
+	/* -- Worker Utility function --
+	 * Finds a running map task eligible for speculative re-execution and marks it
+	 * as speculated. Returns the task (or WorkerContext::no_task if there's none),
+	 * and the worker running it */
+	static int64_t find_straggler(
+		WorkerContext* worker_ctx, int64_t now_ns, WorkerContext** straggler);
+
+	/* -- Worker Utility function --
+	 * Returns the median map task duration (or a negative value if no task has completed).
+	 * The median is recomputed only once the completions have grown by a fraction of
+	 * their number since it was last taken, so the recomputations take linear time in total */
+	static int64_t map_median_duration(WorkerContext* worker_ctx);
+
+	// Deleting all the pairs of the given vector and clearing it
+	static void discard_pairs(IntermediateVec& pairs);
+
 	/**
 	 * -- Worker Utility function --
 	 * The shuffle stage is executed by one of the worker threads
 	 * The shuffle stage is responsible for grouping the intermediates by key
 	 * Note: This function is NOT thread-safe, as it is only called by one worker */
-	static void worker_shuffle_stage(Job* job_context);
+	static void worker_shuffle_stage(WorkerContext* worker_ctx);
+
+	/**
+	 * -- Worker Utility function --
+	 * Merges the shuffled groups into the groups retained from the base job, and
+	 * queues for reduce only the groups which received new pairs.
+	 * Note: Like the shuffle, this function is only called by one worker */
+	static void merge_retained_groups(Job* job_context);
+
+	/**
+	 * -- Worker Utility function --
+	 * Creates the reduce tasks for the given groups of the shuffle queue. Groups which are
+	 * too large for a single worker are split into parts, if the client's reduce allows it.
+	 * Note: Like the shuffle, this function is only called by one worker */
+	static void create_reduce_tasks(
+		Job* job_context, const std::vector<uint32_t>& groups);
+
+	/* -- Worker Utility function --
+	 * Runs a single reduce task on the worker. The partial outputs of a split group's
+	 * part are kept aside, and merged by the worker completing the last part */
+	static void worker_run_reduce_task(
+		WorkerContext* worker_ctx, uint32_t task_index);
+
+	/* -- Worker Utility function --
+	 * Reduces a part of a split group, and merges the group if it's the last part */
+	static void worker_reduce_part(
+		WorkerContext* worker_ctx, const ReduceTask& task);
+
+	/* -- Worker Utility function --
+	 * Placing the outputs of the workers in the job's output, ordered by their slots.
+	 * All the workers take part, each placing its own outputs */
+	static void worker_sorted_output_stage(
+		WorkerContext* worker_ctx);
 
 	/**
 	 * Entrypoint for a job worker thread
@@ -111,20 +318,63 @@ private:
 	CSemaphore m_shuffle_semaphore;
 	// Mutex for synchronizing access to the output vector when reducing (add_output)
 	MutexPtr m_output_mutex;
-	// Mutex for synchronizing access to the shuffle queue when reducing (worker)
-	MutexPtr m_reduce_mutex;
-	/* The stage counter is a 64-bit bitfield, with the following structure:
-	 * 31-bit processed entries counter, 31-bit total entries counter, 2-bit stage ID */
+	/* The stage status is a 64-bit bitfield, with the following structure:
+	 * 31 unused bits, 31-bit total entries counter, 2-bit stage ID
+	 * It changes only on stage transitions, so it's kept apart from the claim counter
+	 * below, letting progress readers poll it without disturbing the workers */
+	char m_stage_status_padding[Common::cache_line_size];
 	std::atomic<uint64_t> m_stage_status;
+	char m_next_entry_padding[Common::cache_line_size];
+	// The index of the next entry to claim on the current stage
+	std::atomic<uint32_t> m_next_entry;
+	char m_next_entry_padding_after[Common::cache_line_size];
 	// Boolean flag to indicate whether the shuffle job has been assigned to one of the workers
 	std::atomic<bool> m_shuffleAssign;
+	// The number of map tasks each worker runs concurrently as fibers (if greater than 1)
+	const uint32_t m_map_fibers;
+	// Whether straggling map tasks may be re-executed (the client's map is idempotent)
+	const bool m_speculate;
+	// Per map task flags - whether the task has been completed by any run,
+	// and whether it has already been re-executed (once at most)
+	std::unique_ptr<std::atomic<bool>[]> m_map_task_done;
+	std::unique_ptr<std::atomic<bool>[]> m_map_task_speculated;
+	std::atomic<uint32_t> m_map_tasks_completed;
+	// Durations of the completed map tasks, for finding the stage median - One slot
+	// per completion (in the order of completion), negative until written
+	std::unique_ptr<std::atomic<int64_t>[]> m_map_durations;
+	// The median of the durations, as of the number of completions it was taken at.
+	// Taken again (by one idle worker at a time) once enough tasks have completed since
+	std::atomic<int64_t> m_median_duration;
+	std::atomic<uint32_t> m_median_completions;
+	std::atomic<bool> m_median_updating;
+	std::atomic<uint32_t> m_speculative_launched;
+	std::atomic<uint32_t> m_speculative_won;
 	std::vector<ThreadPtr> m_workers;
 	// The worker's context. These shall not be destroyed before
 	// all the threads terminate. And note that these will be destroyed
 	// upon the destruction of the job (these are unique pointers)
 	std::vector<WorkerContextUPtr> m_workers_context;
-	// The queue created by the shuffle stage (input of the reduce stage)
+	// The groups created by the shuffle stage in ascending key order (input of the reduce stage)
 	std::vector<IntermediateVec> m_shuffle_queue;
+	// The entries of the reduce stage, claimed by the workers in order
+	std::vector<ReduceTask> m_reduce_tasks;
+	// The groups which were split into parts
+	std::vector<SplitGroupUPtr> m_split_groups;
+	// The number of split groups, for reading the stats while the job is running
+	std::atomic<uint32_t> m_hot_keys_split;
+	const bool m_sorted_output;
+	// Per reduce task (slot) - The number of outputs in the slot during the reduce stage,
+	// and the slot's offset in the output vector afterwards
+	std::vector<size_t> m_slot_outputs;
+	// Synchronizing the workers when placing sorted outputs
+	Barrier m_output_barrier;
+	std::atomic<bool> m_output_assign;
+	// Whether the shuffled groups are kept after the job completes
+	const bool m_retain;
+	// The groups taken over from the base job, until merged by the shuffle
+	std::vector<IntermediateVec> m_retained_groups;
+	// Whether the retained groups have been taken over by another job (which may happen once)
+	std::atomic<bool> m_retained_taken;
 };
 
 #endif // JOB_CONTEXT_H
\ No newline at end of file
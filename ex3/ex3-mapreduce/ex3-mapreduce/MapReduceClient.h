@@ -62,6 +62,24 @@ public:
 	// calls emit3(K3, V3, context) any number of times (usually once)
 	// to output (K3, V3) pairs.
 	virtual void reduce(const IntermediateVec* pairs, void* context) const = 0;
+
+	// returns true if map may safely run more than once for the same input pair.
+	// the framework may then re-execute straggling map tasks on idle workers,
+	// keeping the pairs of the first run to complete and deleting the others'.
+	virtual bool is_map_idempotent() const { return false; }
+
+	// returns true if reduce may be called with only a part of a K2 key's pairs,
+	// in which case merge is called to combine the results of all the parts.
+	// the framework may then split keys with a very large number of pairs
+	// into parts, reduced in parallel. a client returning true must override merge.
+	virtual bool is_reduce_mergeable() const { return false; }
+
+	// gets the (K3, V3) pairs emitted by reducing each part of a single K2 key's pairs
+	// and calls emit3(K3, V3, context) any number of times (usually once)
+	// to output the combined (K3, V3) pairs. the given pairs are not output -
+	// merge owns them, and must delete them (or emit them as they are).
+	// the default is a system error, as the outputs of the split key would be lost.
+	virtual void merge(const OutputVec* partials, void* context) const;
 };
 
 
@@ -1,5 +1,7 @@
 #include <cassert>
 #include <cstdlib>
+#include <iostream>
+#include <unistd.h>
 
 #include "MapReduceFramework.h"
 #include "Job.h"
@@ -11,6 +13,15 @@ static void terminate(Job* job)
 	exit(1);
 }
 
+void MapReduceClient::merge(const OutputVec* partials, void* context) const
+{
+	// Reached only if the client allows splitting keys, but has nothing to combine their parts with
+	(void)partials;
+	(void)context;
+	std::cout << "system error: is_reduce_mergeable() is true, but merge isn't overridden" << std::endl;
+	exit(1);
+}
+
 void emit2(K2* key, V2* value, void* context)
 {
 	try
@@ -18,7 +29,7 @@ void emit2(K2* key, V2* value, void* context)
 		assert(nullptr != context);
 
 		WorkerContext* workerContext = static_cast<WorkerContext*>(context);
-		workerContext->intermediateVec.push_back(std::make_pair(key, value));
+		workerContext->emit_intermediate(std::make_pair(key, value));
 	}
 	catch (...)
 	{
@@ -33,12 +44,54 @@ void emit3(K3* key, V3* value, void* context)
 		assert(nullptr != context);
 
 		WorkerContext* workerContext = static_cast<WorkerContext*>(context);
-		workerContext->jobContext->add_output(key, value);
+		workerContext->emit_output(std::make_pair(key, value));
+	}
+	catch (...)
+	{
+		terminate(static_cast<Job*>(context));
+	}
+}
+
+void mapSleep(unsigned int usecs, void* context)
+{
+	try
+	{
+		assert(nullptr != context);
+
+		WorkerContext* workerContext = static_cast<WorkerContext*>(context);
+		if (nullptr != workerContext->executor)
+		{
+			workerContext->executor->sleep(usecs);
+		}
+		else
+		{
+			usleep(usecs);
+		}
+	}
+	catch (...)
+	{
+		terminate(static_cast<Job*>(context));
+	}
+}
+
+ssize_t mapRead(int fd, void* buf, size_t count, void* context)
+{
+	try
+	{
+		assert(nullptr != context);
+
+		WorkerContext* workerContext = static_cast<WorkerContext*>(context);
+		if (nullptr != workerContext->executor)
+		{
+			workerContext->executor->wait_readable(fd);
+		}
 	}
 	catch (...)
 	{
 		terminate(static_cast<Job*>(context));
 	}
+
+	return read(fd, buf, count);
 }
 
 JobHandle startMapReduceJob(
@@ -46,12 +99,60 @@ JobHandle startMapReduceJob(
 	const InputVec& inputVec, 
 	OutputVec& outputVec,
 	int multiThreadLevel)
+{
+	const JobOptions options = {};
+	return startMapReduceJobWithOptions(
+		client, inputVec, outputVec, multiThreadLevel, options);
+}
+
+JobHandle startMapReduceJobWithOptions(
+	const MapReduceClient& client,
+	const InputVec& inputVec, 
+	OutputVec& outputVec,
+	int multiThreadLevel,
+	const JobOptions& options)
 {
 	Job* job_context = nullptr;
 	try
 	{
 		job_context = new Job(
-			inputVec, outputVec, client, multiThreadLevel);
+			inputVec, outputVec, client, multiThreadLevel, options);
+		job_context->start_job();
+	}
+	catch (...)
+	{
+		terminate(job_context);
+	}
+
+	return job_context;
+}
+
+JobHandle startIncrementalMapReduceJob(
+	const MapReduceClient& client,
+	JobHandle baseJob,
+	const InputVec& deltaInputVec,
+	OutputVec& outputVec,
+	int multiThreadLevel)
+{
+	const JobOptions options = {};
+	return startIncrementalMapReduceJob(
+		client, baseJob, deltaInputVec, outputVec, multiThreadLevel, options);
+}
+
+JobHandle startIncrementalMapReduceJob(
+	const MapReduceClient& client,
+	JobHandle baseJob,
+	const InputVec& deltaInputVec,
+	OutputVec& outputVec,
+	int multiThreadLevel,
+	const JobOptions& options)
+{
+	Job* job_context = nullptr;
+	try
+	{
+		job_context = new Job(
+			deltaInputVec, outputVec, client, multiThreadLevel, options,
+			true, static_cast<Job*>(baseJob));
 		job_context->start_job();
 	}
 	catch (...)
@@ -88,6 +189,19 @@ void getJobState(JobHandle job, JobState* state)
 	}
 }
 
+void getJobStats(JobHandle job, JobStats* stats)
+{
+	try
+	{
+		Job* jobContext = static_cast<Job*>(job);
+		jobContext->get_stats(stats);
+	}
+	catch (...)
+	{
+		terminate(static_cast<Job*>(job));
+	}
+}
+
 void closeJobHandle(JobHandle job)
 {
 	try
@@ -1,6 +1,8 @@
 #ifndef MAPREDUCEFRAMEWORK_H
 #define MAPREDUCEFRAMEWORK_H
 
+#include <sys/types.h>
+
 #include "MapReduceClient.h"
 
 typedef void* JobHandle;
@@ -12,15 +14,66 @@ typedef struct {
 	float percentage;
 } JobState;
 
+typedef struct {
+	// Number of straggling map tasks which were re-executed on an idle worker
+	unsigned int speculativeLaunched;
+	// Number of re-executions which completed before the original run
+	unsigned int speculativeWon;
+	// Number of keys whose pairs were split into parts reduced in parallel
+	unsigned int hotKeysSplit;
+} JobStats;
+
+/* Optional behaviors of a job. Zero-initialized options (JobOptions options = {};)
+ * select the default behavior of startMapReduceJob */
+typedef struct {
+	// Output the pairs ordered by the K2 keys they were reduced from, rather than in the
+	// order the reduces complete (the outputs of a single reduce keep their order)
+	bool sortedOutput;
+	// When greater than 1, each worker runs this many map tasks concurrently as fibers,
+	// switching between them whenever one waits in mapSleep or mapRead. Meant for maps
+	// which mostly wait, rather than compute. Straggling map tasks are not re-executed
+	// in this mode (see MapReduceClient::is_map_idempotent)
+	unsigned int mapFibersPerWorker;
+} JobOptions;
+
 void emit2 (K2* key, V2* value, void* context);
 void emit3 (K3* key, V3* value, void* context);
 
+/* Blocking operations for the client's map and reduce (context is the context given to
+ * them). When map tasks run as fibers (see JobOptions::mapFibersPerWorker), these suspend
+ * only the calling map task, and the worker runs other map tasks meanwhile. Otherwise,
+ * these block the calling worker, same as usleep and read. */
+void mapSleep(unsigned int usecs, void* context);
+// The descriptor is waited on until readable, and then read once (like read)
+ssize_t mapRead(int fd, void* buf, size_t count, void* context);
+
 JobHandle startMapReduceJob(const MapReduceClient& client,
 	const InputVec& inputVec, OutputVec& outputVec,
 	int multiThreadLevel);
 
+JobHandle startMapReduceJobWithOptions(const MapReduceClient& client,
+	const InputVec& inputVec, OutputVec& outputVec,
+	int multiThreadLevel, const JobOptions& options);
+
+/* Starts a job which keeps its grouped intermediate pairs once complete, so a follow-up
+ * job over input appended since only maps the new input and reduces only the keys which
+ * received new pairs (with all of their pairs, old and new).
+ * baseJob - A completed job started by this function, whose retained pairs are taken
+ *			 over by the new job (baseJob may still be closed afterwards), or nullptr to
+ *			 start a new chain of incremental jobs. A job may be the base of a single job,
+ *			 starting a second job from it is a system error.
+ * Unlike regular jobs, the framework owns the intermediate pairs - reduce must not delete
+ * them. outputVec receives the results only of the keys which were reduced. */
+JobHandle startIncrementalMapReduceJob(const MapReduceClient& client,
+	JobHandle baseJob, const InputVec& deltaInputVec, OutputVec& outputVec,
+	int multiThreadLevel);
+JobHandle startIncrementalMapReduceJob(const MapReduceClient& client,
+	JobHandle baseJob, const InputVec& deltaInputVec, OutputVec& outputVec,
+	int multiThreadLevel, const JobOptions& options);
+
 void waitForJob(JobHandle job);
 void getJobState(JobHandle job, JobState* state);
+void getJobStats(JobHandle job, JobStats* stats);
 void closeJobHandle(JobHandle job);
 	
 	
@@ -0,0 +1,155 @@
+/* Benchmark of the job throughput while the job's progress is polled.
+ * Runs a map-heavy job (a short computation per input pair) without a poller, with a thread calling
+ * getJobState at 10 kHz, and with a thread waking up at 10 kHz without calling it (the cost of running
+ * the poller, rather than of reading the progress). Prints the throughput of each run as CSV:
+ * poller,workers,run,pairs_per_sec
+ * Usage: ex3-mapreduce-progress-bench [workers] */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "MapReduceFramework.h"
+
+static constexpr size_t input_size = 1 << 20;
+static constexpr int key_count = 1024;
+static constexpr int map_work_rounds = 64;
+static constexpr int runs = 5;
+static constexpr int default_workers = 4;
+// 10 kHz
+static constexpr std::chrono::microseconds poll_interval(100);
+
+enum poller_t {NO_POLLER, STATE_POLLER, IDLE_POLLER};
+static const char* const poller_names[] = {"none", "10khz", "10khz-idle"};
+
+class VInt : public V1, public V2, public V3
+{
+public:
+	explicit VInt(int value) : value(value) {}
+	int value;
+};
+
+class KInt : public K2, public K3
+{
+public:
+	explicit KInt(int key) : key(key) {}
+	virtual bool operator<(const K2& other) const { return key < static_cast<const KInt&>(other).key; }
+	virtual bool operator<(const K3& other) const { return key < static_cast<const KInt&>(other).key; }
+	int key;
+};
+
+class HashClient : public MapReduceClient
+{
+public:
+	void map(const K1* key, const V1* value, void* context) const
+	{
+		(void)key;
+		// A short computation, so the job's bookkeeping is a noticeable part of each map
+		unsigned int hash = static_cast<unsigned int>(static_cast<const VInt*>(value)->value);
+		for (int round = 0; round < map_work_rounds; ++round)
+		{
+			hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+		}
+		emit2(new KInt(static_cast<int>(hash % key_count)), new VInt(1), context);
+	}
+
+	void reduce(const IntermediateVec* pairs, void* context) const
+	{
+		int count = 0;
+		for (const IntermediatePair& pair : *pairs)
+		{
+			count += static_cast<const VInt*>(pair.second)->value;
+		}
+		KInt* key = new KInt(static_cast<const KInt*>(pairs->at(0).first)->key);
+		for (const IntermediatePair& pair : *pairs)
+		{
+			delete pair.first;
+			delete pair.second;
+		}
+		emit3(key, new VInt(count), context);
+	}
+};
+
+/* Runs the job once, returning its throughput in input pairs per second */
+static double run_job(const HashClient& client, const InputVec& inputVec, int workers, poller_t poll)
+{
+	OutputVec outputVec;
+	std::atomic<bool> done(false);
+
+	const auto start = std::chrono::steady_clock::now();
+	JobHandle job = startMapReduceJob(client, inputVec, outputVec, workers);
+
+	std::thread poller;
+	if (NO_POLLER != poll)
+	{
+		poller = std::thread([job, poll, &done]()
+		{
+			JobState state;
+			auto next = std::chrono::steady_clock::now();
+			while (!done.load())
+			{
+				if (STATE_POLLER == poll)
+				{
+					getJobState(job, &state);
+				}
+				next += poll_interval;
+				std::this_thread::sleep_until(next);
+			}
+		});
+	}
+
+	waitForJob(job);
+	const auto end = std::chrono::steady_clock::now();
+	done = true;
+	if (poller.joinable())
+	{
+		poller.join();
+	}
+	closeJobHandle(job);
+
+	for (OutputPair& pair : outputVec)
+	{
+		delete pair.first;
+		delete pair.second;
+	}
+
+	const double seconds = std::chrono::duration<double>(end - start).count();
+	return static_cast<double>(inputVec.size()) / seconds;
+}
+
+int main(int argc, char** argv)
+{
+	const int workers = (1 < argc) ? std::atoi(argv[1]) : default_workers;
+	if (0 >= workers)
+	{
+		std::fprintf(stderr, "usage: %s [workers]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<VInt> values;
+	values.reserve(input_size);
+	InputVec inputVec;
+	inputVec.reserve(input_size);
+	for (size_t idx = 0; idx < input_size; ++idx)
+	{
+		values.emplace_back(static_cast<int>(idx));
+		inputVec.push_back({nullptr, &values.back()});
+	}
+
+	HashClient client;
+	std::printf("poller,workers,run,pairs_per_sec\n");
+	// The runs alternate, so drifts in the machine's load affect both alike
+	for (int run = 0; run < runs; ++run)
+	{
+		for (const poller_t poll : {NO_POLLER, STATE_POLLER, IDLE_POLLER})
+		{
+			const double throughput = run_job(client, inputVec, workers, poll);
+			std::printf("%s,%d,%d,%.0f\n", poller_names[poll], workers, run, throughput);
+		}
+	}
+
+	return 0;
+}
@@ -1,7 +1,9 @@
 /* This is the simple test written by the course staff - It is not mine */
 
 #include "MapReduceFramework.h"
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <array>
 #include <unistd.h>
@@ -46,7 +48,8 @@ public:
 
 			KChar* k2 = new KChar(i);
 			VCount* v2 = new VCount(counts[i]);
-			usleep(150000);
+			// Waits through the framework, so map tasks running as fibers wait concurrently
+			mapSleep(150000, context);
 			emit2(k2, v2, context);
 		}
 	}
@@ -68,20 +71,29 @@ public:
 };
 
 
+/* Usage: ex3-mapreduce [mapFibersPerWorker [inputRepeats]]
+ * Runs the map tasks as that many fibers per worker, over the input strings repeated that many times
+ * (by default a single map task per worker, over the strings once), and prints the job's throughput */
 int main(int argc, char** argv)
 {
 	CounterClient client;
 	InputVec inputVec;
 	OutputVec outputVec;
+	JobOptions options = {};
+	options.mapFibersPerWorker = (1 < argc) ? std::atoi(argv[1]) : 0;
+	const int repeats = (2 < argc) ? std::atoi(argv[2]) : 1;
 	VString s1("This string is full of characters");
 	VString s2("Multithreading is awesome");
 	VString s3("race conditions are bad");
-	inputVec.push_back({nullptr, &s1});
-	inputVec.push_back({nullptr, &s2});
-	inputVec.push_back({nullptr, &s3});
+	for (int i = 0; i < repeats; ++i) {
+		inputVec.push_back({nullptr, &s1});
+		inputVec.push_back({nullptr, &s2});
+		inputVec.push_back({nullptr, &s3});
+	}
 	JobState state;
     JobState last_state={UNDEFINED_STAGE,0};
-	JobHandle job = startMapReduceJob(client, inputVec, outputVec, 4);
+	const auto start = std::chrono::steady_clock::now();
+	JobHandle job = startMapReduceJobWithOptions(client, inputVec, outputVec, 4, options);
 	getJobState(job, &state);
     
 	while (state.stage != REDUCE_STAGE || state.percentage != 100.0)
@@ -96,7 +108,9 @@ int main(int argc, char** argv)
 	}
 	printf("stage %d, %f%% \n", 
 			state.stage, state.percentage);
-	printf("Done!\n");
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Done! %zu map tasks in %.2f s, %.1f map tasks/s (%u fibers per worker)\n",
+			inputVec.size(), seconds, inputVec.size() / seconds, options.mapFibersPerWorker);
 	
 	closeJobHandle(job);
 	